@@ -0,0 +1,18 @@
+#version 430 core
+
+out vec4 color;
+
+in vec3 worldNormal;
+
+const vec3 lightDirection = normalize(vec3(.3f, 1.f, .5f));
+const vec3 frontColor = vec3(.2f, .5f, .9f);
+const vec3 backColor = vec3(.9f, .5f, .2f);
+
+void main (void)
+{
+	// lit from either side, the back of the cloth in its own color
+	vec3 n = normalize(worldNormal);
+	float diffuse = abs(dot(n, lightDirection));
+	vec3 base = gl_FrontFacing ? frontColor : backColor;
+	color = vec4(base * (.25f + .75f * diffuse), 0.f);
+}
@@ -0,0 +1,18 @@
+#version 430 core
+
+layout (location = 0) in vec3 vertex;
+layout (location = 1) in vec3 normal;
+
+layout (std140, binding = 0) uniform Camera
+{
+	mat4 modelview;
+	mat4 projection;
+};
+
+out vec3 worldNormal;
+
+void main (void)
+{
+	worldNormal = normal;
+    gl_Position = projection * modelview * vec4(vertex, 1.f);
+}
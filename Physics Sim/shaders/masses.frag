@@ -1,8 +1,38 @@
 #version 430 core
 
+layout (std140, binding = 0) uniform Camera
+{
+	mat4 modelview;
+	mat4 projection;
+};
+
+uniform float radius;
+
+in vec2 corner;
+in vec3 center;
+flat in uint massAttributes;
+
 out vec4 color;
 
+const vec3 lightDirection = normalize(vec3(.3f, 1.f, .5f));
+
 void main (void)
 {
-	color = vec4(1.f, 0.f, 0.f, 0.f);
+	// the square becomes a sphere, anything outside the circle is cut away
+	float distance2 = dot(corner, corner);
+	if (distance2 > 1.f)
+		discard;
+	vec3 normal = vec3(corner, sqrt(1.f - distance2));
+
+	// depth of the sphere's surface, so spheres pass through each other properly
+	vec4 surface = projection * vec4(center + normal * radius, 1.f);
+	gl_FragDepth = .5f * surface.z / surface.w + .5f;
+
+	// fixed masses in grey, the rest from blue to red by the packed diagnostic
+	bool anchored = (massAttributes & 1u) != 0u;
+	float value = float(massAttributes >> 16) / 65535.f;
+	vec3 base = anchored ? vec3(.6f) : mix(vec3(.1f, .3f, 1.f), vec3(1.f, .1f, .1f), value);
+
+	float diffuse = max(dot(normal, mat3(modelview) * lightDirection), 0.f);
+	color = vec4(base * (.3f + .7f * diffuse), 0.f);
 }
@@ -1,12 +1,25 @@
 #version 430 core
 
 layout (location = 0) in vec3 vertex;
+layout (location = 1) in uint attributes;
 
-uniform mat4 modelview;
-uniform mat4 projection;
+layout (std140, binding = 0) uniform Camera
+{
+	mat4 modelview;
+	mat4 projection;
+};
+
+uniform float radius;
 
+out vec2 corner;
+out vec3 center;
+flat out uint massAttributes;
 
+// one instance per mass, the four vertices of the strip span a square facing the camera
 void main (void)
 {
-    gl_Position = projection * modelview* vec4(vertex, 1.f);
+	corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.f - 1.f;
+	center = (modelview * vec4(vertex, 1.f)).xyz;
+	massAttributes = attributes;
+    gl_Position = projection * vec4(center + vec3(corner * radius, 0.f), 1.f);
 }
@@ -2,8 +2,11 @@
 
 layout (location = 0) in vec3 vertex;
 
-uniform mat4 modelview;
-uniform mat4 projection;
+layout (std140, binding = 0) uniform Camera
+{
+	mat4 modelview;
+	mat4 projection;
+};
 
 out vec3 vert;
 
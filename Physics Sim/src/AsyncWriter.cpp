@@ -0,0 +1,94 @@
+#include "AsyncWriter.h"
+#include <chrono>
+
+void writerLoop(AsyncWriter *writer)
+{
+	std::unique_lock<std::mutex> lock(writer->mutex);
+	while (true)
+	{
+		while (writer->queue.empty() && !writer->closing)
+			writer->queued.wait(lock);
+		if (writer->queue.empty())
+			break;
+
+		WriteJob *job = writer->queue.front();
+		writer->queue.pop_front();
+
+		// the job is ours until it goes back in the pool, write it without holding the lock
+		lock.unlock();
+		writer->write(writer->stream, *job, writer->context);
+		lock.lock();
+
+		writer->pool.push_back(job);
+		writer->released.notify_one();
+	}
+}
+
+void openWriter(AsyncWriter &writer, FILE *stream, JobWriter write, void *context, unsigned int capacity)
+{
+	writer.stream = stream;
+	writer.write = write;
+	writer.context = context;
+	writer.closing = false;
+	writer.stalls = 0;
+	writer.stallTime = 0.0;
+	writer.deepest = 0;
+
+	writer.jobs.resize(capacity);
+	writer.pool.clear();
+	writer.queue.clear();
+	for (unsigned int i = 0; i < capacity; i++)
+		writer.pool.push_back(&writer.jobs[i]);
+
+	writer.thread = std::thread(writerLoop, &writer);
+}
+
+WriteJob *acquireJob(AsyncWriter &writer)
+{
+	std::unique_lock<std::mutex> lock(writer.mutex);
+	if (writer.pool.empty())
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		while (writer.pool.empty())
+			writer.released.wait(lock);
+		writer.stalls++;
+		writer.stallTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	WriteJob *job = writer.pool.back();
+	writer.pool.pop_back();
+	return job;
+}
+
+void submitJob(AsyncWriter &writer, WriteJob *job)
+{
+	{
+		std::lock_guard<std::mutex> lock(writer.mutex);
+		writer.queue.push_back(job);
+		if (writer.queue.size() > writer.deepest)
+			writer.deepest = (unsigned int)writer.queue.size();
+	}
+	writer.queued.notify_one();
+}
+
+// writes everything still queued and stops the thread, the stream stays open
+void stopWriter(AsyncWriter &writer)
+{
+	if (!writer.thread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(writer.mutex);
+		writer.closing = true;
+	}
+	writer.queued.notify_one();
+	writer.thread.join();
+}
+
+void closeWriter(AsyncWriter &writer)
+{
+	stopWriter(writer);
+	if (writer.stream)
+		fclose(writer.stream);
+	writer.stream = NULL;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// one block of output, filled on the main thread and written on the writer thread
+struct WriteJob
+{
+	std::vector<char> data;
+	unsigned int index;		// position in the sequence, frame number for the renderer
+};
+
+// called on the writer thread for every job in submission order. stream is NULL when
+// the jobs go to files of their own, context is only touched by the writer thread
+typedef void(*JobWriter)(FILE *stream, const WriteJob &job, void *context);
+
+// a fixed pool of jobs cycles between the main thread and the writer thread, so the
+// buffers are allocated once and a slow disk stalls acquireJob instead of growing a queue
+struct AsyncWriter
+{
+	AsyncWriter() :	stream(NULL),
+					write(NULL),
+					context(NULL),
+					closing(false),
+					stalls(0) { }
+	FILE *stream;
+	JobWriter write;
+	void *context;
+
+	std::vector<WriteJob> jobs;
+	std::vector<WriteJob*> pool;		// jobs free to fill
+	std::deque<WriteJob*> queue;
+	std::mutex mutex;
+	std::condition_variable queued, released;
+	std::thread thread;
+	bool closing;
+	unsigned int stalls;	// times acquireJob had to wait on the writer
+	double stallTime;		// seconds spent waiting in those
+	unsigned int deepest;	// most jobs queued at once
+};
+
+void openWriter(AsyncWriter &writer, FILE *stream, JobWriter write, void *context, unsigned int capacity);
+WriteJob *acquireJob(AsyncWriter &writer);
+void submitJob(AsyncWriter &writer, WriteJob *job);
+void stopWriter(AsyncWriter &writer);
+void closeWriter(AsyncWriter &writer);
@@ -0,0 +1,594 @@
+#include "BVH.h"
+#include <algorithm>
+#include <cfloat>
+#include <omp.h>
+
+using namespace glm;
+
+void buildMeshEdges(TriangleMesh &mesh, unsigned int massCount)
+{
+	// every triangle side as (low vertex, high vertex, triangle), sorted so duplicates sit together
+	struct Side { unsigned long long key; unsigned int triangle, slot; };
+	std::vector<Side> sides(mesh.triangles.size());
+	for (unsigned int i = 0; i < mesh.triangles.size(); i++)
+	{
+		unsigned int	a = mesh.triangles[i],
+						b = mesh.triangles[i - i % 3 + (i + 1) % 3];
+		Side side = { ((unsigned long long)min(a, b) << 32) | max(a, b), i / 3, i };
+		sides[i] = side;
+	}
+	std::sort(sides.begin(), sides.end(), [](const Side &l, const Side &r)
+	{
+		return l.key < r.key || (l.key == r.key && l.triangle < r.triangle);
+	});
+
+	mesh.massTriangles.assign(massCount, noTriangle);
+	for (unsigned int i = (unsigned int)mesh.triangles.size(); i-- > 0;)
+		mesh.massTriangles[mesh.triangles[i]] = i / 3;
+
+	mesh.edges.clear();
+	mesh.triangleEdges.resize(mesh.triangles.size());
+	for (unsigned int i = 0; i < sides.size(); i++)
+	{
+		if (i == 0 || sides[i].key != sides[i - 1].key)
+		{
+			Edge e;
+			e.m1 = (unsigned int)(sides[i].key >> 32);
+			e.m2 = (unsigned int)sides[i].key;
+			e.triangle = sides[i].triangle;
+			mesh.edges.push_back(e);
+		}
+		mesh.triangleEdges[sides[i].slot] = (unsigned int)mesh.edges.size() - 1;
+	}
+
+	// edges as adjacency lists, compressed into one array
+	mesh.neighbourStart.assign(massCount + 1, 0);
+	for (unsigned int i = 0; i < mesh.edges.size(); i++)
+	{
+		mesh.neighbourStart[mesh.edges[i].m1 + 1]++;
+		mesh.neighbourStart[mesh.edges[i].m2 + 1]++;
+	}
+	for (unsigned int i = 0; i < massCount; i++)
+		mesh.neighbourStart[i + 1] += mesh.neighbourStart[i];
+	mesh.neighbours.resize(2 * mesh.edges.size());
+	std::vector<unsigned int> fill(mesh.neighbourStart.begin(), mesh.neighbourStart.end() - 1);
+	for (unsigned int i = 0; i < mesh.edges.size(); i++)
+	{
+		mesh.neighbours[fill[mesh.edges[i].m1]++] = mesh.edges[i].m2;
+		mesh.neighbours[fill[mesh.edges[i].m2]++] = mesh.edges[i].m1;
+	}
+}
+
+bool adjacent(const TriangleMesh &mesh, unsigned int m1, unsigned int m2)
+{
+	if (m1 == m2)
+		return true;
+	for (unsigned int i = mesh.neighbourStart[m1]; i < mesh.neighbourStart[m1 + 1]; i++)
+		if (mesh.neighbours[i] == m2)
+			return true;
+	return false;
+}
+
+
+// construction
+float surfaceArea(vec3 lower, vec3 upper)
+{
+	vec3 size = upper - lower;
+	return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+void triangleBounds(const std::vector<Mass> &masses, const TriangleMesh &mesh, unsigned int triangle, vec3 &lower, vec3 &upper)
+{
+	const vec3	&a = masses[mesh.triangles[3 * triangle]].position,
+				&b = masses[mesh.triangles[3 * triangle + 1]].position,
+				&c = masses[mesh.triangles[3 * triangle + 2]].position;
+	lower = min(a, min(b, c));
+	upper = max(a, max(b, c));
+}
+
+int buildNode(BVH &bvh, const std::vector<vec3> &centroids, int first, int count)
+{
+	int index = (int)bvh.nodes.size();
+	bvh.nodes.push_back(BVHNode());
+	bvh.nodes[index].left = bvh.nodes[index].right = -1;
+	bvh.nodes[index].first = first;
+	bvh.nodes[index].count = count;
+
+	if (count <= bvhLeafSize)
+		return index;
+
+	// median split along the widest axis of the centroids
+	vec3	lower = centroids[bvh.order[first]],
+			upper = lower;
+	for (int i = first + 1; i < first + count; i++)
+	{
+		lower = min(lower, centroids[bvh.order[i]]);
+		upper = max(upper, centroids[bvh.order[i]]);
+	}
+	vec3 extent = upper - lower;
+	int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+	int half = count / 2;
+	std::nth_element(bvh.order.begin() + first, bvh.order.begin() + first + half, bvh.order.begin() + first + count,
+		[&centroids, axis](unsigned int l, unsigned int r) { return centroids[l][axis] < centroids[r][axis]; });
+
+	int left = buildNode(bvh, centroids, first, half);
+	int right = buildNode(bvh, centroids, first + half, count - half);
+	bvh.nodes[index].left = left;
+	bvh.nodes[index].right = right;
+	bvh.nodes[index].count = 0;
+	return index;
+}
+
+void buildBVH(BVH &bvh, const std::vector<Mass> &masses, const TriangleMesh &mesh, float margin)
+{
+	unsigned int triangleCount = (unsigned int)mesh.triangles.size() / 3;
+	bvh.nodes.clear();
+	bvh.levelNodes.clear();
+	bvh.levelStart.clear();
+	bvh.order.resize(triangleCount);
+	bvh.gathered.clear();
+	if (triangleCount == 0)
+		return;
+
+	std::vector<vec3> centroids(triangleCount);
+	for (unsigned int i = 0; i < triangleCount; i++)
+	{
+		bvh.order[i] = i;
+		centroids[i] = (masses[mesh.triangles[3 * i]].position +
+						masses[mesh.triangles[3 * i + 1]].position +
+						masses[mesh.triangles[3 * i + 2]].position) / 3.f;
+	}
+	bvh.nodes.reserve(2 * triangleCount / bvhLeafSize + 1);
+	buildNode(bvh, centroids, 0, triangleCount);
+
+	// group the nodes by depth so a refit can do a whole level in parallel
+	std::vector<int> depth(bvh.nodes.size(), 0);
+	int maxDepth = 0;
+	for (unsigned int i = 0; i < bvh.nodes.size(); i++)
+	{
+		if (bvh.nodes[i].left < 0)
+			continue;
+		depth[bvh.nodes[i].left] = depth[bvh.nodes[i].right] = depth[i] + 1;
+		maxDepth = max(maxDepth, depth[i] + 1);
+	}
+	bvh.levelStart.assign(maxDepth + 2, 0);
+	for (unsigned int i = 0; i < depth.size(); i++)
+		bvh.levelStart[depth[i] + 1]++;
+	for (int d = 0; d <= maxDepth; d++)
+		bvh.levelStart[d + 1] += bvh.levelStart[d];
+	bvh.levelNodes.resize(bvh.nodes.size());
+	std::vector<int> fill(bvh.levelStart.begin(), bvh.levelStart.end() - 1);
+	for (unsigned int i = 0; i < depth.size(); i++)
+		bvh.levelNodes[fill[depth[i]]++] = i;
+
+	refitBVH(bvh, masses, mesh, margin);
+
+	bvh.builtArea = 0.f;
+	for (unsigned int i = 0; i < bvh.nodes.size(); i++)
+		bvh.builtArea += surfaceArea(bvh.nodes[i].lower, bvh.nodes[i].upper);
+}
+
+void refitBVH(BVH &bvh, const std::vector<Mass> &masses, const TriangleMesh &mesh, float margin)
+{
+	bvh.margin = margin;
+	bvh.lower.resize(bvh.order.size());
+	bvh.upper.resize(bvh.order.size());
+	// deepest level first, children are always one level below their parent
+	for (int d = (int)bvh.levelStart.size() - 2; d >= 0; d--)
+	{
+		#pragma omp parallel for
+		for (int n = bvh.levelStart[d]; n < bvh.levelStart[d + 1]; n++)
+		{
+			BVHNode &node = bvh.nodes[bvh.levelNodes[n]];
+			if (node.left < 0)
+			{
+				for (int i = node.first; i < node.first + node.count; i++)
+				{
+					vec3 lower, upper;
+					triangleBounds(masses, mesh, bvh.order[i], lower, upper);
+					bvh.lower[i] = lower - vec3(margin);
+					bvh.upper[i] = upper + vec3(margin);
+				}
+				node.lower = bvh.lower[node.first];
+				node.upper = bvh.upper[node.first];
+				for (int i = node.first + 1; i < node.first + node.count; i++)
+				{
+					node.lower = min(node.lower, bvh.lower[i]);
+					node.upper = max(node.upper, bvh.upper[i]);
+				}
+			}
+			else
+			{
+				node.lower = min(bvh.nodes[node.left].lower, bvh.nodes[node.right].lower);
+				node.upper = max(bvh.nodes[node.left].upper, bvh.nodes[node.right].upper);
+			}
+		}
+	}
+}
+
+void updateBVH(BVH &bvh, const std::vector<Mass> &masses, const TriangleMesh &mesh, float margin)
+{
+	refitBVH(bvh, masses, mesh, margin);
+
+	// refitting keeps the topology of the first build, once the boxes overlap too much
+	// the queries slow down more than a rebuild costs
+	float area = 0.f;
+	for (unsigned int i = 0; i < bvh.nodes.size(); i++)
+		area += surfaceArea(bvh.nodes[i].lower, bvh.nodes[i].upper);
+	if (area > bvhRebuildRatio * bvh.builtArea)
+		buildBVH(bvh, masses, mesh, margin);
+}
+
+
+// queries
+inline bool boxesOverlap(vec3 lowerA, vec3 upperA, vec3 lowerB, vec3 upperB)
+{
+	return	lowerA.x <= upperB.x && upperA.x >= lowerB.x &&
+			lowerA.y <= upperB.y && upperA.y >= lowerB.y &&
+			lowerA.z <= upperB.z && upperA.z >= lowerB.z;
+}
+
+inline bool overlaps(const BVHNode &node, vec3 lower, vec3 upper)
+{
+	return boxesOverlap(node.lower, node.upper, lower, upper);
+}
+
+// calls visit(node) for every leaf overlapping the box
+template <typename Visit>
+void traverseLeaves(const BVH &bvh, vec3 lower, vec3 upper, Visit visit)
+{
+	if (bvh.nodes.empty())
+		return;
+	int stack[64], top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		int index = stack[--top];
+		const BVHNode &node = bvh.nodes[index];
+		if (!overlaps(node, lower, upper))
+			continue;
+		if (node.left < 0)
+			visit(index);
+		else
+		{
+			stack[top++] = node.left;
+			stack[top++] = node.right;
+		}
+	}
+}
+
+// calls visit(triangle) for every triangle whose grown box overlaps the box
+template <typename Visit>
+void traverseBVH(const BVH &bvh, vec3 lower, vec3 upper, Visit visit)
+{
+	traverseLeaves(bvh, lower, upper, [&](int leaf)
+	{
+		const BVHNode &node = bvh.nodes[leaf];
+		for (int i = node.first; i < node.first + node.count; i++)
+			if (boxesOverlap(bvh.lower[i], bvh.upper[i], lower, upper))
+				visit(bvh.order[i]);
+	});
+}
+
+// Real-Time Collision Detection (Ericson) 5.1.5, returns the barycentric coordinates
+vec3 closestPointTriangle(vec3 p, vec3 a, vec3 b, vec3 c)
+{
+	vec3 ab = b - a, ac = c - a, ap = p - a;
+	float d1 = dot(ab, ap), d2 = dot(ac, ap);
+	if (d1 <= 0.f && d2 <= 0.f) return vec3(1.f, 0.f, 0.f);
+
+	vec3 bp = p - b;
+	float d3 = dot(ab, bp), d4 = dot(ac, bp);
+	if (d3 >= 0.f && d4 <= d3) return vec3(0.f, 1.f, 0.f);
+
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+	{
+		float v = d1 / (d1 - d3);
+		return vec3(1.f - v, v, 0.f);
+	}
+
+	vec3 cp = p - c;
+	float d5 = dot(ab, cp), d6 = dot(ac, cp);
+	if (d6 >= 0.f && d5 <= d6) return vec3(0.f, 0.f, 1.f);
+
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+	{
+		float w = d2 / (d2 - d6);
+		return vec3(1.f - w, 0.f, w);
+	}
+
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f)
+	{
+		float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		return vec3(0.f, 1.f - w, w);
+	}
+
+	float denom = 1.f / (va + vb + vc);
+	float v = vb * denom, w = vc * denom;
+	return vec3(1.f - v - w, v, w);
+}
+
+// Real-Time Collision Detection (Ericson) 5.1.9, parameters of the closest points
+void closestPointsSegments(vec3 p1, vec3 q1, vec3 p2, vec3 q2, float &s, float &t)
+{
+	vec3 d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+	float a = dot(d1, d1), e = dot(d2, d2), f = dot(d2, r);
+	const float epsilon = 1e-12f;
+
+	if (a <= epsilon && e <= epsilon) { s = t = 0.f; return; }
+	if (a <= epsilon)
+	{
+		s = 0.f;
+		t = clamp(f / e, 0.f, 1.f);
+		return;
+	}
+	float c = dot(d1, r);
+	if (e <= epsilon)
+	{
+		t = 0.f;
+		s = clamp(-c / a, 0.f, 1.f);
+		return;
+	}
+	float b = dot(d1, d2), denom = a * e - b * b;
+	s = denom != 0.f ? clamp((b * f - c * e) / denom, 0.f, 1.f) : 0.f;
+	t = (b * s + f) / e;
+	if (t < 0.f)
+	{
+		t = 0.f;
+		s = clamp(-c / a, 0.f, 1.f);
+	}
+	else if (t > 1.f)
+	{
+		t = 1.f;
+		s = clamp((b - c) / a, 0.f, 1.f);
+	}
+}
+
+// each thread gathers into its own list, the lists are joined in thread order
+template <typename Found>
+void joinFound(std::vector<std::vector<Found> > &perThread, std::vector<Found> &found)
+{
+	found.clear();
+	for (unsigned int t = 0; t < perThread.size(); t++)
+		found.insert(found.end(), perThread[t].begin(), perThread[t].end());
+}
+
+// pairs sorted by their first then second index, the order the contacts come out in whenever
+// and however the candidates were gathered
+bool pairBefore(uvec2 l, uvec2 r)
+{
+	return l.x < r.x || (l.x == r.x && l.y < r.y);
+}
+
+bool vertexTriangleCandidate(const std::vector<Mass> &masses, const TriangleMesh &mesh, unsigned int v, unsigned int tri, float reach)
+{
+	// most of what is near a mass in a sheet is its own ring, cheaper to rule out first
+	const unsigned int *ids = &mesh.triangles[3 * tri];
+	if (adjacent(mesh, v, ids[0]) || adjacent(mesh, v, ids[1]) || adjacent(mesh, v, ids[2]))
+		return false;
+	vec3	p = masses[v].position,
+			a = masses[ids[0]].position,
+			b = masses[ids[1]].position,
+			c = masses[ids[2]].position,
+			bary = closestPointTriangle(p, a, b, c);
+	// a crushed triangle may have no closest point, it is kept for when it opens up again
+	return !(length(p - (bary.x * a + bary.y * b + bary.z * c)) >= reach);
+}
+
+bool edgeEdgeCandidate(const std::vector<Mass> &masses, const TriangleMesh &mesh, unsigned int e, unsigned int f, float reach)
+{
+	const Edge	&edgeA = mesh.edges[e],
+				&edgeB = mesh.edges[f];
+	if (adjacent(mesh, edgeA.m1, edgeB.m1) || adjacent(mesh, edgeA.m1, edgeB.m2) ||
+		adjacent(mesh, edgeA.m2, edgeB.m1) || adjacent(mesh, edgeA.m2, edgeB.m2))
+		return false;
+	vec3	a0 = masses[edgeA.m1].position,
+			a1 = masses[edgeA.m2].position,
+			b0 = masses[edgeB.m1].position,
+			b1 = masses[edgeB.m2].position;
+	if (!boxesOverlap(min(a0, a1) - vec3(reach), max(a0, a1) + vec3(reach), min(b0, b1), max(b0, b1)))
+		return false;
+	float s, t;
+	closestPointsSegments(a0, a1, b0, b1, s, t);
+	return length(mix(a0, a1, s) - mix(b0, b1, t)) < reach;
+}
+
+// every pair between two different triangles, each side's masses and edges against the other.
+// a mass or an edge only speaks for the triangle that owns it so no pair comes up twice
+void gatherTrianglePair(const std::vector<Mass> &masses, const TriangleMesh &mesh, unsigned int t, unsigned int u, float reach,
+						std::vector<uvec2> &vertexTriangles, std::vector<uvec2> &edgeEdges)
+{
+	for (int k = 0; k < 3; k++)
+	{
+		unsigned int	tm = mesh.triangles[3 * t + k],
+						um = mesh.triangles[3 * u + k];
+		if (mesh.massTriangles[tm] == t && vertexTriangleCandidate(masses, mesh, tm, u, reach))
+			vertexTriangles.push_back(uvec2(tm, u));
+		if (mesh.massTriangles[um] == u && vertexTriangleCandidate(masses, mesh, um, t, reach))
+			vertexTriangles.push_back(uvec2(um, t));
+	}
+	for (int k = 0; k < 3; k++)
+	{
+		unsigned int e = mesh.triangleEdges[3 * t + k];
+		if (mesh.edges[e].triangle != t)
+			continue;
+		for (int l = 0; l < 3; l++)
+		{
+			unsigned int f = mesh.triangleEdges[3 * u + l];
+			if (mesh.edges[f].triangle == u && edgeEdgeCandidate(masses, mesh, e, f, reach))
+				edgeEdges.push_back(uvec2(min(e, f), max(e, f)));
+		}
+	}
+}
+
+// one query per leaf rather than per mass and edge, the padded boxes of a crumpled sheet
+// overlap so much that the walk down the tree costs more than the pairs it finds
+void gatherCandidates(const BVH &bvh, const std::vector<Mass> &masses, const TriangleMesh &mesh, float reach,
+					  std::vector<uvec2> &vertexTriangles, std::vector<uvec2> &edgeEdges)
+{
+	std::vector<std::vector<uvec2> >	foundVertexTriangles(omp_get_max_threads()),
+										foundEdgeEdges(omp_get_max_threads());
+	std::vector<int> leaves;
+	for (unsigned int i = 0; i < bvh.nodes.size(); i++)
+		if (bvh.nodes[i].left < 0)
+			leaves.push_back(i);
+	const int leafCount = (int)leaves.size();
+	// two boxes already carry the margin each, only grow them by what is left
+	const float gap = max(reach - 2.f * bvh.margin, 0.f);
+
+	#pragma omp parallel for schedule(dynamic, 16)
+	for (int n = 0; n < leafCount; n++)
+	{
+		std::vector<uvec2>	&vertexFound = foundVertexTriangles[omp_get_thread_num()],
+							&edgeFound = foundEdgeEdges[omp_get_thread_num()];
+		const BVHNode &leaf = bvh.nodes[leaves[n]];
+
+		traverseLeaves(bvh, leaf.lower - vec3(gap), leaf.upper + vec3(gap), [&](int other)
+		{
+			// each pair of leaves once, from the lower one
+			if (other < leaves[n])
+				return;
+			const BVHNode &otherLeaf = bvh.nodes[other];
+			for (int i = leaf.first; i < leaf.first + leaf.count; i++)
+			{
+				for (int j = other == leaves[n] ? i + 1 : otherLeaf.first; j < otherLeaf.first + otherLeaf.count; j++)
+				{
+					if (boxesOverlap(bvh.lower[i] - vec3(gap), bvh.upper[i] + vec3(gap), bvh.lower[j], bvh.upper[j]))
+						gatherTrianglePair(masses, mesh, bvh.order[i], bvh.order[j], reach, vertexFound, edgeFound);
+				}
+			}
+		});
+	}
+
+	// masses outside every triangle, another body's, still collide with the sheet
+	const int massCount = (int)masses.size();
+	const float pad = max(reach - bvh.margin, 0.f);
+	#pragma omp parallel for schedule(static)
+	for (int v = 0; v < massCount; v++)
+	{
+		if (mesh.massTriangles[v] != noTriangle)
+			continue;
+		std::vector<uvec2> &vertexFound = foundVertexTriangles[omp_get_thread_num()];
+		vec3 p = masses[v].position;
+		traverseBVH(bvh, p - vec3(pad), p + vec3(pad), [&](unsigned int tri)
+		{
+			if (vertexTriangleCandidate(masses, mesh, v, tri, reach))
+				vertexFound.push_back(uvec2(v, tri));
+		});
+	}
+
+	joinFound(foundVertexTriangles, vertexTriangles);
+	joinFound(foundEdgeEdges, edgeEdges);
+	std::sort(vertexTriangles.begin(), vertexTriangles.end(), pairBefore);
+	std::sort(edgeEdges.begin(), edgeEdges.end(), pairBefore);
+}
+
+void updateCandidates(BVH &bvh, const std::vector<Mass> &masses, const TriangleMesh &mesh, float radius)
+{
+	// a pair's distance shrinks by at most what its two masses moved apart from any motion they
+	// share, the middle of every mass's move here. the candidates hold every pair that can be in
+	// contact until a mass has strayed half the slack from it, a falling sheet keeps its pairs
+	const float slack = contactSlack * radius;
+	if (bvh.gathered.size() == masses.size() && bvh.margin == radius)
+	{
+		vec3	lower(FLT_MAX),
+				upper(-FLT_MAX);
+		for (unsigned int i = 0; i < masses.size(); i++)
+		{
+			vec3 moved = masses[i].position - bvh.gathered[i];
+			lower = min(lower, moved);
+			upper = max(upper, moved);
+		}
+		vec3 shared = .5f * (lower + upper);
+		bool stale = false;
+		for (unsigned int i = 0; !stale && i < masses.size(); i++)
+		{
+			vec3 strayed = masses[i].position - bvh.gathered[i] - shared;
+			stale = dot(strayed, strayed) > .25f * slack * slack;
+		}
+		if (!stale)
+			return;
+	}
+
+	updateBVH(bvh, masses, mesh, radius);
+	gatherCandidates(bvh, masses, mesh, radius + slack, bvh.vertexTriangles, bvh.edgeEdges);
+	bvh.gathered.resize(masses.size());
+	for (unsigned int i = 0; i < masses.size(); i++)
+		bvh.gathered[i] = masses[i].position;
+}
+
+void vertexTriangleContacts(const BVH &bvh, const std::vector<Mass> &masses, const TriangleMesh &mesh, float radius, std::vector<VertexTriangleContact> &contacts)
+{
+	std::vector<std::vector<VertexTriangleContact> > perThread(omp_get_max_threads());
+	const int pairCount = (int)bvh.vertexTriangles.size();
+
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < pairCount; i++)
+	{
+		unsigned int	v = bvh.vertexTriangles[i].x,
+						tri = bvh.vertexTriangles[i].y;
+		const unsigned int *ids = &mesh.triangles[3 * tri];
+		vec3	p = masses[v].position,
+				a = masses[ids[0]].position,
+				b = masses[ids[1]].position,
+				c = masses[ids[2]].position,
+				faceNormal = cross(b - a, c - a);
+		// crushed to a line or a point it has no side to push out of, its edges still collide
+		if (dot(faceNormal, faceNormal) < degenerateTriangle)
+			continue;
+		vec3	bary = closestPointTriangle(p, a, b, c),
+				delta = p - (bary.x * a + bary.y * b + bary.z * c);
+		float dist = length(delta);
+		if (dist >= radius)
+			continue;
+
+		VertexTriangleContact contact;
+		contact.vertex = v;
+		contact.triangle = tri;
+		contact.barycentric = bary;
+		contact.distance = dist;
+		// a vertex sitting on the triangle is pushed along the face normal
+		contact.normal = dist > 0.f ? delta / dist : normalize(faceNormal);
+		perThread[omp_get_thread_num()].push_back(contact);
+	}
+	joinFound(perThread, contacts);
+}
+
+void edgeEdgeContacts(const BVH &bvh, const std::vector<Mass> &masses, const TriangleMesh &mesh, float radius, std::vector<EdgeEdgeContact> &contacts)
+{
+	std::vector<std::vector<EdgeEdgeContact> > perThread(omp_get_max_threads());
+	const int pairCount = (int)bvh.edgeEdges.size();
+
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < pairCount; i++)
+	{
+		unsigned int	e = bvh.edgeEdges[i].x,
+						f = bvh.edgeEdges[i].y;
+		const Edge	&edgeA = mesh.edges[e],
+					&edgeB = mesh.edges[f];
+		vec3	a0 = masses[edgeA.m1].position,
+				a1 = masses[edgeA.m2].position,
+				b0 = masses[edgeB.m1].position,
+				b1 = masses[edgeB.m2].position;
+		float s, t;
+		closestPointsSegments(a0, a1, b0, b1, s, t);
+		vec3 delta = mix(a0, a1, s) - mix(b0, b1, t);
+		float dist = length(delta);
+		if (dist >= radius || dist == 0.f)
+			continue;
+
+		EdgeEdgeContact contact;
+		contact.edgeA = e;
+		contact.edgeB = f;
+		contact.s = s;
+		contact.t = t;
+		contact.normal = delta / dist;
+		contact.distance = dist;
+		perThread[omp_get_thread_num()].push_back(contact);
+	}
+	joinFound(perThread, contacts);
+}
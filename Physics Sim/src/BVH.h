@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Header.h"
+
+#define bvhLeafSize			4
+#define bvhRebuildRatio		1.5f	// rebuild once refitted boxes grow this much past the fresh build
+#define degenerateTriangle	1e-16f	// squared cross product of its sides below which a triangle has no normal
+#define contactSlack		1.f		// candidate pairs are gathered this many radii past the contact radius
+#define noTriangle			0xffffffffu
+
+struct Edge
+{
+	unsigned int m1, m2;
+	unsigned int triangle;		// first triangle using the edge, it reports edge pairs
+};
+
+struct TriangleMesh
+{
+	std::vector<unsigned int>	triangles,		// 3 mass indices per triangle
+								triangleEdges,	// 3 edge indices per triangle
+								neighbourStart,	// per mass offsets into neighbours
+								neighbours,		// masses sharing an edge with each mass
+								massTriangles;	// first triangle using each mass, it reports the mass's pairs
+	std::vector<Edge>			edges;
+};
+
+struct BVHNode
+{
+	glm::vec3 lower, upper;
+	int left, right;			// children, -1 for leaves
+	int first, count;			// range of BVH::order covered by a leaf
+};
+
+struct BVH
+{
+	BVH() : margin(0.f), builtArea(0.f) { }
+	std::vector<BVHNode> nodes;
+	std::vector<unsigned int> order;	// triangle indices in leaf order
+	std::vector<glm::vec3>	lower,		// each triangle's box grown by the margin, in leaf order
+							upper;
+	std::vector<int>	levelNodes,		// node indices grouped by depth
+						levelStart;		// offsets into levelNodes, one per depth + 1
+	float margin;						// every box is grown by this much past its triangles
+	float builtArea;					// summed node surface area of the last build
+	std::vector<glm::uvec2>	vertexTriangles,	// candidate pairs, vertex and triangle or edge and edge
+							edgeEdges;
+	std::vector<glm::vec3>	gathered;		// where the masses were when the candidates were gathered
+};
+
+struct VertexTriangleContact
+{
+	unsigned int vertex, triangle;
+	glm::vec3 barycentric;
+	glm::vec3 normal;			// points from the triangle towards the vertex
+	float distance;
+};
+
+struct EdgeEdgeContact
+{
+	unsigned int edgeA, edgeB;
+	float s, t;					// closest points along each edge
+	glm::vec3 normal;			// points from edge b towards edge a
+	float distance;
+};
+
+void buildMeshEdges(TriangleMesh &mesh, unsigned int massCount);
+bool adjacent(const TriangleMesh &mesh, unsigned int m1, unsigned int m2);
+
+void buildBVH(BVH &bvh, const std::vector<Mass> &masses, const TriangleMesh &mesh, float margin);
+void refitBVH(BVH &bvh, const std::vector<Mass> &masses, const TriangleMesh &mesh, float margin);
+void updateBVH(BVH &bvh, const std::vector<Mass> &masses, const TriangleMesh &mesh, float margin);
+
+// refits and gathers the candidates again once a mass has moved far enough that a pair left out
+// could have come within radius. pairs that share a mass or an edge are never candidates, those
+// are already close at rest
+void updateCandidates(BVH &bvh, const std::vector<Mass> &masses, const TriangleMesh &mesh, float radius);
+
+// the candidates within radius, in the candidates' order
+void vertexTriangleContacts(const BVH &bvh, const std::vector<Mass> &masses, const TriangleMesh &mesh, float radius, std::vector<VertexTriangleContact> &contacts);
+void edgeEdgeContacts(const BVH &bvh, const std::vector<Mass> &masses, const TriangleMesh &mesh, float radius, std::vector<EdgeEdgeContact> &contacts);
@@ -0,0 +1,328 @@
+#include "Batch.h"
+#include "Broadphase.h"
+#include "BVH.h"
+#include "Colliders.h"
+#include "Collision.h"
+#include "Topology.h"
+#include <omp.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace glm;
+
+unsigned int sweepRuns(const SceneDescription &scene)
+{
+	unsigned int runs = 1;
+	for (unsigned int i = 0; i < scene.sweep.size(); i++)
+		runs *= (unsigned int)scene.sweep[i].values.size();
+	return runs;
+}
+
+// the last parameter changes fastest, as nested loops in the order the file lists them
+std::vector<float> sweepValues(const SceneDescription &scene, unsigned int run)
+{
+	std::vector<float> values(scene.sweep.size());
+	for (int i = (int)scene.sweep.size() - 1; i >= 0; i--)
+	{
+		const std::vector<float> &listed = scene.sweep[i].values;
+		values[i] = listed[run % listed.size()];
+		run /= (unsigned int)listed.size();
+	}
+	return values;
+}
+
+SceneDescription applySweep(const SceneDescription &scene, const std::vector<float> &values)
+{
+	SceneDescription swept = scene;
+	for (unsigned int i = 0; i < scene.sweep.size(); i++)
+	{
+		const std::string &name = scene.sweep[i].name;
+		float value = values[i];
+		if (name == "damping")
+		{
+			swept.solver.damping = value;
+			continue;
+		}
+		int layers = max(1, (int)(value + .5f));
+		for (unsigned int b = 0; b < swept.bodies.size(); b++)
+		{
+			BodyDescription &body = swept.bodies[b];
+			if (name == "stiffness")		body.stiffness = value;
+			else if (name == "mass")		body.mass = value;
+			else if (name == "spacing")		body.spacing = value;
+			// only the axes the body has, a chain stays a line and a cloth a sheet
+			else if (name == "layers")
+			{
+				if (body.type == chainBody)			body.layers.x = layers;
+				else if (body.type == clothBody)	body.layers = ivec3(layers, layers, 1);
+				else if (body.type == latticeBody)	body.layers = ivec3(layers);
+			}
+		}
+	}
+	return swept;
+}
+
+void measureRun(BatchResult &result, const std::vector<Mass> &masses, const std::vector<Spring> &springs)
+{
+	result.masses = (unsigned int)masses.size();
+	result.springs = (unsigned int)springs.size();
+	float totalMass = 0.f, weightedHeight = 0.f;
+	result.lowest = masses.empty() ? 0.f : masses[0].position.y;
+	for (unsigned int i = 0; i < masses.size(); i++)
+	{
+		const Mass &m = masses[i];
+		float speed = length(m.velocity);
+		result.kineticEnergy += .5f * m.mass * speed * speed;
+		result.maxSpeed = max(result.maxSpeed, speed);
+		result.lowest = min(result.lowest, m.position.y);
+		totalMass += m.mass;
+		weightedHeight += m.mass * m.position.y;
+	}
+	result.centerHeight = totalMass > 0.f ? weightedHeight / totalMass : 0.f;
+	for (unsigned int i = 0; i < springs.size(); i++)
+	{
+		const Spring &s = springs[i];
+		float strain = length(masses[s.m1].position - masses[s.m2].position) / s.restLength - 1.f;
+		result.maxStrain = max(result.maxStrain, strain);
+	}
+}
+
+// a nan or an infinity anywhere carries through the sum
+bool finitePositions(const std::vector<Mass> &masses)
+{
+	float sum = 0.f;
+	for (unsigned int i = 0; i < masses.size(); i++)
+		sum += masses[i].position.x + masses[i].position.y + masses[i].position.z;
+	return std::isfinite(sum);
+}
+
+BatchResult runScene(const SceneDescription &scene, unsigned int frames, const ImportedFiles *files)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	BatchResult result;
+
+	std::vector<Mass> masses;
+	std::vector<Spring> springs;
+	std::vector<Body> bodies;
+	TriangleMesh mesh;
+	SceneBodies built = { masses, springs, mesh.triangles, bodies };
+	if (!buildBodies(built, scene, files))
+		return result;
+	result.built = true;
+	const unsigned int springCount = (unsigned int)springs.size();
+
+	// what prepareScene derives for the window's scene
+	SolverSettings settings = scene.solver;
+	ColliderSet colliders;
+	colliders.colliders = scene.colliders;
+	colliders.fields = scene.fields;
+	SpringKernel kernel = selectSpringKernel(masses, springs, scene.planeSize);
+	BVH bvh;
+	buildMeshEdges(mesh, (unsigned int)masses.size());
+	buildBVH(bvh, masses, mesh, settings.thickness);
+	settings.meshCollision = scene.solver.meshCollision && !mesh.triangles.empty();
+	SpringTopology topology;
+	buildTopology(topology, (unsigned int)masses.size(), springs);
+	SortAndSweep broadphase;
+
+	result.stable = true;
+	for (unsigned int frame = 0; frame < frames && result.stable; frame++)
+	{
+		for (int i = 0; i < timeStep; i++)
+		{
+			beginColliderStep(colliders, masses);
+			kernel(masses, springs, scene.planeHeight, scene.planeSize, settings.damping);
+			collideColliders(masses, colliders);
+			if (bodies.size() > 1)
+				collideBodies(masses, bodies, broadphase, settings.contactDistance);
+			// one or the other, mass against mass stands in for the triangles when asked for
+			if (settings.selfCollision)
+				selfCollision(masses, settings.thickness);
+			else if (settings.meshCollision)
+				meshCollision(masses, mesh, bvh, settings.thickness);
+			if (settings.tearThreshold > 0.f)
+				tearSprings(topology, masses, springs, settings.tearThreshold);
+		}
+		result.stable = finitePositions(masses);
+		result.frames = frame + 1;
+	}
+
+	measureRun(result, masses, springs);
+	result.tornSprings = springCount - (unsigned int)springs.size();
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+
+// the scheduler
+
+struct BatchQueue
+{
+	std::mutex lock;
+	std::deque<unsigned int> runs;
+};
+
+struct BatchWork
+{
+	const SceneDescription *scene;
+	const ImportedFiles *files;							// read before the workers start
+	std::vector<std::unique_ptr<BatchQueue> > queues;	// one per worker
+	std::vector<BatchResult> results;					// by run, each written by one worker
+	std::atomic<unsigned int> finished, unstable, failed, steals;
+};
+
+bool takeRun(BatchQueue &queue, bool front, unsigned int &run)
+{
+	std::lock_guard<std::mutex> guard(queue.lock);
+	if (queue.runs.empty())
+		return false;
+	if (front)
+	{
+		run = queue.runs.front();
+		queue.runs.pop_front();
+	}
+	else
+	{
+		run = queue.runs.back();
+		queue.runs.pop_back();
+	}
+	return true;
+}
+
+// nothing is added once the workers start, so every deque empty means the batch is done
+bool nextRun(BatchWork &work, unsigned int worker, unsigned int &run)
+{
+	if (takeRun(*work.queues[worker], true, run))
+		return true;
+	const unsigned int workers = (unsigned int)work.queues.size();
+	for (unsigned int i = 1; i < workers; i++)
+		if (takeRun(*work.queues[(worker + i) % workers], false, run))
+		{
+			work.steals++;
+			return true;
+		}
+	return false;
+}
+
+void batchWorker(BatchWork &work, unsigned int worker)
+{
+	// the run is the unit of parallelism, the solver's loops stay on this core
+	omp_set_num_threads(1);
+	unsigned int run;
+	while (nextRun(work, worker, run))
+	{
+		const SceneDescription &scene = *work.scene;
+		BatchResult result = runScene(applySweep(scene, sweepValues(scene, run)), scene.sweepFrames, work.files);
+		if (!result.built)
+			work.failed++;
+		else if (!result.stable)
+			work.unstable++;
+		work.results[run] = result;
+		work.finished++;
+	}
+}
+
+bool writeBatchResults(const std::string &filename, const SceneDescription &scene, const std::vector<BatchResult> &results)
+{
+	FILE *file = fopen(filename.c_str(), "w");
+	if (!file)
+	{
+		std::cout << "FILE " << filename << " COULD NOT BE OPENED" << std::endl;
+		return false;
+	}
+	fprintf(file, "run");
+	for (unsigned int i = 0; i < scene.sweep.size(); i++)
+		fprintf(file, ",%s", scene.sweep[i].name.c_str());
+	fprintf(file, ",masses,springs,frames,built,stable,seconds,kinetic_energy,max_speed,max_strain,torn_springs,lowest,center_height\n");
+	for (unsigned int run = 0; run < results.size(); run++)
+	{
+		const BatchResult &r = results[run];
+		std::vector<float> values = sweepValues(scene, run);
+		fprintf(file, "%u", run);
+		for (unsigned int i = 0; i < values.size(); i++)
+			fprintf(file, ",%g", values[i]);
+		fprintf(file, ",%u,%u,%u,%d,%d,%.4f,%g,%g,%g,%u,%g,%g\n", r.masses, r.springs, r.frames, (int)r.built, (int)r.stable, r.seconds,
+			r.kineticEnergy, r.maxSpeed, r.maxStrain, r.tornSprings, r.lowest, r.centerHeight);
+	}
+	fclose(file);
+	return true;
+}
+
+bool runBatch(const std::string &filename, const std::string &output, unsigned int threads)
+{
+	SceneDescription scene;
+	if (!readSceneFile(filename, scene))
+		return false;
+	const unsigned int runs = sweepRuns(scene);
+	if (runs == 0)
+	{
+		std::cout << "FILE " << filename << " HAS NO RUNS, a sweep parameter lists no values" << std::endl;
+		return false;
+	}
+	// every run builds from the same files, read here once rather than by every worker
+	ImportedFiles files;
+	if (!importFiles(scene, files))
+		return false;
+	if (threads == 0)
+		threads = max(1u, std::thread::hardware_concurrency());
+	threads = min(threads, runs);
+
+	BatchWork work;
+	work.scene = &scene;
+	work.files = &files;
+	work.results.resize(runs);
+	work.finished = 0;
+	work.unstable = 0;
+	work.failed = 0;
+	work.steals = 0;
+	// neighbouring runs differ in the last parameter, so a block costs about the same as the next
+	for (unsigned int i = 0; i < threads; i++)
+	{
+		work.queues.push_back(std::unique_ptr<BatchQueue>(new BatchQueue));
+		for (unsigned int run = i * runs / threads; run < (i + 1) * runs / threads; run++)
+			work.queues[i]->runs.push_back(run);
+	}
+
+	std::cout << "Running " << runs << " runs of " << scene.sweepFrames << " frames on " << threads << " threads" << std::endl;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for (unsigned int i = 0; i < threads; i++)
+		workers.push_back(std::thread(batchWorker, std::ref(work), i));
+
+	// a line when runs have finished since the last one, at most every batchProgress seconds
+	double reported = 0.0;
+	unsigned int reportedRuns = 0;
+	while (work.finished < runs)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		unsigned int finished = work.finished;
+		if (elapsed - reported >= batchProgress && finished != reportedRuns && finished < runs)
+		{
+			reported = elapsed;
+			reportedRuns = finished;
+			std::cout << "  " << finished << " of " << runs << " runs, " << work.unstable << " unstable, " << work.failed << " not built" << std::endl;
+		}
+	}
+	for (unsigned int i = 0; i < threads; i++)
+		workers[i].join();
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	double simulated = 0.0;
+	for (unsigned int run = 0; run < runs; run++)
+		simulated += work.results[run].seconds;
+	std::cout	<< "Ran " << runs << " runs in " << wall << " s, " << simulated << " s of simulation, "
+				<< work.unstable << " unstable";
+	if (work.failed)
+		std::cout << " and " << work.failed << " could not be built";
+	std::cout	<< std::endl << "  " << work.steals << " runs were stolen from another thread's queue" << std::endl;
+	return writeBatchResults(output + ".csv", scene, work.results) && work.failed == 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Header.h"
+#include "Scene.h"
+#include <string>
+
+// runs a scene file once for every combination of its [sweep] values, with no window and
+// no rendering. the runs are small and independent so each is simulated whole on one
+// core, single threaded, and the cores share them out rather than one run at a time
+//
+// every worker starts with a contiguous block of the runs in a deque of its own and works
+// from the front of it. one that runs out steals from the back of the others', so a
+// block of slow runs does not leave the rest of the cores idle at the end
+//
+// a row per run goes to output.csv, in the order the runs were listed whichever core
+// simulated them
+
+#define batchProgress		1.f		// seconds between progress lines
+
+// how a run ended, measured after its last frame
+struct BatchResult
+{
+	BatchResult() :	masses(0), springs(0), frames(0), stable(false), seconds(0.0),
+					kineticEnergy(0.f), maxSpeed(0.f), maxStrain(0.f), tornSprings(0),
+					lowest(0.f), centerHeight(0.f), built(false) { }
+	unsigned int masses, springs;
+	unsigned int frames;		// simulated, fewer than asked for if it blew up
+	bool stable;				// every position still finite, false too if it was not built
+	double seconds;
+	float kineticEnergy;
+	float maxSpeed;
+	float maxStrain;			// stretch over rest length of the most stretched spring
+	unsigned int tornSprings;
+	float lowest;				// height of the lowest mass
+	float centerHeight;			// height of the center of mass
+	bool built;					// false if the scene could not be built, nothing else is set
+};
+
+// one combination of the sweep, a value per parameter
+std::vector<float> sweepValues(const SceneDescription &scene, unsigned int run);
+unsigned int sweepRuns(const SceneDescription &scene);
+
+// the scene with a combination applied, stiffness, mass, spacing and layers to every body
+// and damping to the solver
+SceneDescription applySweep(const SceneDescription &scene, const std::vector<float> &values);
+
+// simulates frames physics frames of the scene, the same substeps the window's scene takes.
+// its bodies' files come from files when given, read again otherwise
+BatchResult runScene(const SceneDescription &scene, unsigned int frames, const ImportedFiles *files = NULL);
+
+// threads 0 is one per core
+bool runBatch(const std::string &filename, const std::string &output, unsigned int threads);
@@ -0,0 +1,123 @@
+#include "Broadphase.h"
+
+using namespace glm;
+
+void updateBodyBounds(std::vector<Body> &bodies, const std::vector<Mass> &masses, float margin)
+{
+	const int bodyCount = (int)bodies.size();
+	#pragma omp parallel for
+	for (int b = 0; b < bodyCount; b++)
+	{
+		Body &body = bodies[b];
+		body.lower = body.upper = masses[body.firstMass].position;
+		for (unsigned int i = body.firstMass + 1; i < body.firstMass + body.massCount; i++)
+		{
+			body.lower = min(body.lower, masses[i].position);
+			body.upper = max(body.upper, masses[i].position);
+		}
+		body.lower -= vec3(margin);
+		body.upper += vec3(margin);
+	}
+}
+
+void sortAndSweep(SortAndSweep &broadphase, const std::vector<Body> &bodies)
+{
+	std::vector<unsigned int> &order = broadphase.order;
+	if (order.size() != bodies.size())
+	{
+		order.resize(bodies.size());
+		for (unsigned int i = 0; i < order.size(); i++)
+			order[i] = i;
+	}
+
+	// insertion sort, the order from the last substep is almost right already
+	for (unsigned int i = 1; i < order.size(); i++)
+	{
+		unsigned int body = order[i];
+		float key = bodies[body].lower.x;
+		int j = (int)i - 1;
+		while (j >= 0 && bodies[order[j]].lower.x > key)
+		{
+			order[j + 1] = order[j];
+			j--;
+		}
+		order[j + 1] = body;
+	}
+
+	// sweep along x, only bodies whose x intervals overlap are checked on y and z
+	broadphase.pairs.clear();
+	for (unsigned int i = 0; i < order.size(); i++)
+	{
+		const Body &a = bodies[order[i]];
+		for (unsigned int j = i + 1; j < order.size() && bodies[order[j]].lower.x <= a.upper.x; j++)
+		{
+			const Body &b = bodies[order[j]];
+			if (a.lower.y <= b.upper.y && a.upper.y >= b.lower.y &&
+				a.lower.z <= b.upper.z && a.upper.z >= b.lower.z)
+			{
+				BodyPair pair = { order[i], order[j] };
+				broadphase.pairs.push_back(pair);
+			}
+		}
+	}
+}
+
+bool inside(vec3 p, vec3 lower, vec3 upper)
+{
+	return	p.x >= lower.x && p.y >= lower.y && p.z >= lower.z &&
+			p.x <= upper.x && p.y <= upper.y && p.z <= upper.z;
+}
+
+void collideBodies(std::vector<Mass> &masses, std::vector<Body> &bodies, SortAndSweep &broadphase, float contactDistance)
+{
+	// half the contact distance on each body, overlapping bounds then mean masses may touch
+	updateBodyBounds(bodies, masses, .5f * contactDistance);
+	sortAndSweep(broadphase, bodies);
+
+	// narrowphase, only the masses of b inside a's bounds can touch a
+	for (unsigned int p = 0; p < broadphase.pairs.size(); p++)
+	{
+		const Body	&a = bodies[broadphase.pairs[p].a],
+					&b = bodies[broadphase.pairs[p].b];
+
+		broadphase.candidates.clear();
+		for (unsigned int j = b.firstMass; j < b.firstMass + b.massCount; j++)
+			if (inside(masses[j].position, a.lower, a.upper))
+				broadphase.candidates.push_back(j);
+		if (broadphase.candidates.empty())
+			continue;
+
+		for (unsigned int i = a.firstMass; i < a.firstMass + a.massCount; i++)
+		{
+			Mass &m1 = masses[i];
+			if (!inside(m1.position, b.lower, b.upper))
+				continue;
+
+			for (unsigned int c = 0; c < broadphase.candidates.size(); c++)
+			{
+				Mass &m2 = masses[broadphase.candidates[c]];
+				vec3 delta = m1.position - m2.position;
+				float dist2 = dot(delta, delta);
+				if (dist2 >= contactDistance * contactDistance || dist2 == 0.f)
+					continue;
+
+				float	dist = sqrt(dist2),
+						inverse1 = m1.fixed ? 0.f : 1.f / m1.mass,
+						inverse2 = m2.fixed ? 0.f : 1.f / m2.mass,
+						inverseSum = inverse1 + inverse2;
+				if (inverseSum == 0.f)
+					continue;
+				vec3 normal = delta / dist;
+
+				// cancel the approach and separate the pair, split by inverse mass
+				float approach = dot(m1.velocity - m2.velocity, normal);
+				float impulse = approach < 0.f ? -approach / inverseSum : 0.f;
+				float push = (contactDistance - dist) / inverseSum;
+				m1.velocity += inverse1 * impulse * normal;
+				m2.velocity -= inverse2 * impulse * normal;
+				m1.position += inverse1 * push * normal;
+				m2.position -= inverse2 * push * normal;
+			}
+		}
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Header.h"
+
+// an independent spring network, a contiguous range of massVec
+struct Body
+{
+	unsigned int firstMass, massCount;
+	glm::vec3 lower, upper;
+};
+
+struct BodyPair
+{
+	unsigned int a, b;
+};
+
+// bodies stay sorted on the lower x of their bounds between substeps, they barely move
+// in one step so the insertion sort that restores the order is close to linear
+struct SortAndSweep
+{
+	std::vector<unsigned int> order;
+	std::vector<BodyPair> pairs;
+	std::vector<unsigned int> candidates;	// scratch for the narrowphase
+};
+
+void updateBodyBounds(std::vector<Body> &bodies, const std::vector<Mass> &masses, float margin);
+void sortAndSweep(SortAndSweep &broadphase, const std::vector<Body> &bodies);
+void collideBodies(std::vector<Mass> &masses, std::vector<Body> &bodies, SortAndSweep &broadphase, float contactDistance);
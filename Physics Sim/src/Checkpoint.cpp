@@ -0,0 +1,245 @@
+#include "Checkpoint.h"
+#include "FileMap.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+using namespace glm;
+
+template <typename T>
+void writeArray(FILE *stream, const T *data, size_t count)
+{
+	if (count)
+		fwrite(data, sizeof(T), count, stream);
+}
+
+// written beside the old checkpoint and renamed over it, so a run stopped halfway through
+// a write still has the last complete one
+bool writeCheckpoint(const std::string &filename, const SceneState &scene)
+{
+	std::string temporary = filename + ".tmp";
+	FILE *stream = fopen(temporary.c_str(), "wb");
+	if (!stream)
+	{
+		std::cout << "Could not open " << temporary << " for the checkpoint" << std::endl;
+		return false;
+	}
+
+	CheckpointHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = checkpointMagic;
+	header.version = checkpointVersion;
+	header.state = scene.state;
+	header.frame = scene.frame;
+	header.planeHeight = scene.planeHeight;
+	header.planeSize = scene.planeSize;
+	header.selfCollision = scene.solver.selfCollision;
+	header.meshCollision = scene.solver.meshCollision;
+	header.thickness = scene.solver.thickness;
+	header.contactDistance = scene.solver.contactDistance;
+	header.tearThreshold = scene.solver.tearThreshold;
+	header.damping = scene.solver.damping;
+	header.massCount = (unsigned int)scene.masses.size();
+	header.springCount = (unsigned int)scene.springs.size();
+	header.triangleCount = (unsigned int)scene.mesh.triangles.size() / 3;
+	header.colliderCount = (unsigned int)scene.colliders.colliders.size();
+	header.fieldCount = (unsigned int)scene.colliders.fields.size();
+	header.bodyCount = (unsigned int)scene.bodies.size();
+	header.broadphaseCount = (unsigned int)scene.broadphase.order.size();
+	header.nodeCount = (unsigned int)scene.bvh.nodes.size();
+	header.leafCount = (unsigned int)scene.bvh.order.size();
+	header.levelNodeCount = (unsigned int)scene.bvh.levelNodes.size();
+	header.levelCount = (unsigned int)scene.bvh.levelStart.size();
+	header.bvhMargin = scene.bvh.margin;
+	header.bvhBuiltArea = scene.bvh.builtArea;
+	fwrite(&header, sizeof(header), 1, stream);
+
+	std::vector<CheckpointMass> masses(scene.masses.size());
+	for (unsigned int i = 0; i < masses.size(); i++)
+	{
+		const Mass &m = scene.masses[i];
+		CheckpointMass &c = masses[i];
+		memcpy(c.position, &m.position, sizeof(c.position));
+		memcpy(c.velocity, &m.velocity, sizeof(c.velocity));
+		memcpy(c.force, &m.force, sizeof(c.force));
+		c.mass = m.mass;
+		c.fixed = m.fixed;
+	}
+	writeArray(stream, masses.data(), masses.size());
+	writeArray(stream, scene.springs.data(), scene.springs.size());
+	writeArray(stream, scene.mesh.triangles.data(), 3 * (size_t)header.triangleCount);
+	writeArray(stream, scene.colliders.colliders.data(), scene.colliders.colliders.size());
+	for (unsigned int i = 0; i < header.fieldCount; i++)
+	{
+		const SignedDistanceField &f = scene.colliders.fields[i];
+		CheckpointField field;
+		memcpy(field.resolution, &f.resolution, sizeof(field.resolution));
+		memcpy(field.origin, &f.origin, sizeof(field.origin));
+		field.cellSize = f.cellSize;
+		field.distanceCount = (unsigned int)f.distances.size();
+		fwrite(&field, sizeof(field), 1, stream);
+		writeArray(stream, f.distances.data(), f.distances.size());
+	}
+	writeArray(stream, scene.bodies.data(), scene.bodies.size());
+	writeArray(stream, scene.broadphase.order.data(), scene.broadphase.order.size());
+	writeArray(stream, scene.bvh.nodes.data(), scene.bvh.nodes.size());
+	writeArray(stream, scene.bvh.order.data(), scene.bvh.order.size());
+	writeArray(stream, scene.bvh.levelNodes.data(), scene.bvh.levelNodes.size());
+	writeArray(stream, scene.bvh.levelStart.data(), scene.bvh.levelStart.size());
+
+	bool failed = ferror(stream) != 0;
+	if (fclose(stream) != 0 || failed)
+	{
+		std::cout << "Could not write the checkpoint to " << temporary << std::endl;
+		remove(temporary.c_str());
+		return false;
+	}
+
+#ifdef _WIN32
+	// rename will not replace a file here
+	remove(filename.c_str());
+#endif
+	if (rename(temporary.c_str(), filename.c_str()) != 0)
+	{
+		std::cout << "Could not move the checkpoint to " << filename << std::endl;
+		return false;
+	}
+	return true;
+}
+
+
+// reading walks the mapping once, every section is bounds checked before it is copied
+struct CheckpointReader
+{
+	const unsigned char *at, *end;
+};
+
+template <typename T>
+bool readArray(CheckpointReader &reader, std::vector<T> &out, size_t count)
+{
+	if (count > (size_t)(reader.end - reader.at) / sizeof(T))
+		return false;
+	out.resize(count);
+	if (count)
+		memcpy(out.data(), reader.at, count * sizeof(T));
+	reader.at += count * sizeof(T);
+	return true;
+}
+
+bool readCheckpoint(const std::string &filename, SceneState &scene)
+{
+	FileMap file;
+	if (!mapFile(file, filename))
+		return false;
+
+	CheckpointHeader header;
+	if (file.size >= sizeof(header))
+		memcpy(&header, file.data, sizeof(header));
+	if (file.size < sizeof(header) || header.magic != checkpointMagic)
+	{
+		std::cout << "FILE " << filename << " IS NOT A CHECKPOINT" << std::endl;
+		unmapFile(file);
+		return false;
+	}
+	if (header.version != checkpointVersion)
+	{
+		std::cout << "Checkpoint " << filename << " is version " << header.version << ", expected " << checkpointVersion << std::endl;
+		unmapFile(file);
+		return false;
+	}
+
+	// into locals first, a bad file then leaves the running scene alone
+	CheckpointReader reader = { file.data + sizeof(header), file.data + file.size };
+	std::vector<CheckpointMass> masses;
+	std::vector<Spring> springs;
+	std::vector<unsigned int> triangles;
+	std::vector<Collider> colliders;
+	std::vector<SignedDistanceField> fields;
+	std::vector<Body> bodies;
+	std::vector<unsigned int> order;
+	BVH bvh;
+	bool valid =	readArray(reader, masses, header.massCount) &&
+					readArray(reader, springs, header.springCount) &&
+					readArray(reader, triangles, 3 * (size_t)header.triangleCount) &&
+					readArray(reader, colliders, header.colliderCount);
+	for (unsigned int i = 0; valid && i < header.fieldCount; i++)
+	{
+		std::vector<CheckpointField> field;
+		fields.resize(i + 1);
+		valid = readArray(reader, field, 1) && readArray(reader, fields[i].distances, field[0].distanceCount);
+		if (valid)
+		{
+			memcpy(&fields[i].resolution, field[0].resolution, sizeof(field[0].resolution));
+			memcpy(&fields[i].origin, field[0].origin, sizeof(field[0].origin));
+			fields[i].cellSize = field[0].cellSize;
+			measureFieldSlope(fields[i]);
+		}
+	}
+	valid = valid &&	readArray(reader, bodies, header.bodyCount) &&
+						readArray(reader, order, header.broadphaseCount) &&
+						readArray(reader, bvh.nodes, header.nodeCount) &&
+						readArray(reader, bvh.order, header.leafCount) &&
+						readArray(reader, bvh.levelNodes, header.levelNodeCount) &&
+						readArray(reader, bvh.levelStart, header.levelCount) &&
+						reader.at == reader.end;
+
+	// indices are trusted by the solver, check them here rather than crash in a step
+	for (unsigned int i = 0; valid && i < springs.size(); i++)
+		valid = springs[i].m1 < header.massCount && springs[i].m2 < header.massCount;
+	for (unsigned int i = 0; valid && i < triangles.size(); i++)
+		valid = triangles[i] < header.massCount;
+	for (unsigned int i = 0; valid && i < bodies.size(); i++)
+		valid = bodies[i].firstMass + bodies[i].massCount <= header.massCount;
+	for (unsigned int i = 0; valid && i < order.size(); i++)
+		valid = order[i] < header.bodyCount;
+	for (unsigned int i = 0; valid && i < bvh.nodes.size(); i++)
+	{
+		const BVHNode &node = bvh.nodes[i];
+		valid = node.left < (int)header.nodeCount && node.right < (int)header.nodeCount &&
+				node.first >= 0 && node.count >= 0 && (unsigned int)(node.first + node.count) <= header.leafCount;
+	}
+	for (unsigned int i = 0; valid && i < bvh.order.size(); i++)
+		valid = bvh.order[i] < header.triangleCount;
+	for (unsigned int i = 0; valid && i < bvh.levelNodes.size(); i++)
+		valid = bvh.levelNodes[i] >= 0 && bvh.levelNodes[i] < (int)header.nodeCount;
+	unmapFile(file);
+	if (!valid)
+	{
+		std::cout << "Checkpoint " << filename << " is damaged" << std::endl;
+		return false;
+	}
+
+	scene.state = header.state;
+	scene.frame = header.frame;
+	scene.planeHeight = header.planeHeight;
+	scene.planeSize = header.planeSize;
+	scene.solver.selfCollision = header.selfCollision != 0;
+	scene.solver.meshCollision = header.meshCollision != 0;
+	scene.solver.thickness = header.thickness;
+	scene.solver.contactDistance = header.contactDistance;
+	scene.solver.tearThreshold = header.tearThreshold;
+	scene.solver.damping = header.damping;
+
+	scene.masses.resize(masses.size());
+	for (unsigned int i = 0; i < masses.size(); i++)
+	{
+		const CheckpointMass &c = masses[i];
+		Mass &m = scene.masses[i];
+		m.position = make_vec3(c.position);
+		m.velocity = make_vec3(c.velocity);
+		m.force = make_vec3(c.force);
+		m.mass = c.mass;
+		m.fixed = c.fixed != 0;
+	}
+	scene.springs.swap(springs);
+	scene.mesh.triangles.swap(triangles);
+	scene.colliders.colliders.swap(colliders);
+	scene.colliders.fields.swap(fields);
+	scene.bodies.swap(bodies);
+	scene.broadphase.order.swap(order);
+	bvh.margin = header.bvhMargin;
+	bvh.builtArea = header.bvhBuiltArea;
+	std::swap(scene.bvh, bvh);
+	return true;
+}
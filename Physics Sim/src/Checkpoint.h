@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Header.h"
+#include "BVH.h"
+#include "Broadphase.h"
+#include "Colliders.h"
+#include <string>
+
+// checkpoint files, little endian
+//
+//	CheckpointHeader
+//	massCount * CheckpointMass
+//	springCount * Spring
+//	triangleCount * 3 mass indices
+//	colliderCount * Collider
+//	per field, CheckpointField then its distances
+//	bodyCount * Body
+//	broadphaseCount body indices, the sort and sweep order
+//	nodeCount * BVHNode, leafCount triangle indices, levelNodeCount node indices, levelCount offsets
+//
+// everything a step reads that is not rebuilt from the rest the same way every time. the
+// broadphase order and the BVH are kept as they were, they only ever get updated and the
+// contacts come out in their order, so a rebuilt one would not resume bit for bit
+
+#define checkpointMagic			0x4b434850u		// "PHCK"
+#define checkpointVersion		2
+
+struct CheckpointHeader
+{
+	unsigned int magic, version;
+	int state;
+	unsigned int frame;					// physics frames since the scene was built
+	float planeHeight, planeSize;
+
+	// solver settings
+	unsigned int selfCollision, meshCollision;
+	float thickness, contactDistance, tearThreshold, damping;
+
+	unsigned int	massCount, springCount, triangleCount,
+					colliderCount, fieldCount, bodyCount, broadphaseCount,
+					nodeCount, leafCount, levelNodeCount, levelCount;
+	float bvhMargin, bvhBuiltArea;
+};
+
+// Mass without its padding, so the file holds nothing but the state
+struct CheckpointMass
+{
+	float position[3], velocity[3], force[3];
+	float mass;
+	unsigned int fixed;
+};
+
+struct CheckpointField
+{
+	int resolution[3];
+	float origin[3];
+	float cellSize;
+	unsigned int distanceCount;
+};
+
+// the scene's own containers, a read replaces them only once the whole file checks out
+struct SceneState
+{
+	int &state;
+	unsigned int &frame;
+	float &planeHeight, &planeSize;
+	SolverSettings &solver;
+	std::vector<Mass> &masses;
+	std::vector<Spring> &springs;
+	TriangleMesh &mesh;
+	ColliderSet &colliders;
+	std::vector<Body> &bodies;
+	SortAndSweep &broadphase;
+	BVH &bvh;
+};
+
+bool writeCheckpoint(const std::string &filename, const SceneState &scene);
+bool readCheckpoint(const std::string &filename, SceneState &scene);
@@ -0,0 +1,463 @@
+#include "Colliders.h"
+#include <emmintrin.h>
+#include <cfloat>
+#include <omp.h>
+
+using namespace glm;
+
+Collider makeSphere(vec3 center, float radius)
+{
+	Collider c;
+	c.type = sphereCollider;
+	c.center = center;
+	c.radius = radius;
+	return c;
+}
+
+Collider makeBox(vec3 center, vec3 halfExtents, mat3 axes)
+{
+	Collider c;
+	c.type = boxCollider;
+	c.center = center;
+	c.halfExtents = halfExtents;
+	c.axes = axes;
+	return c;
+}
+
+Collider makeCapsule(vec3 a, vec3 b, float radius)
+{
+	Collider c;
+	c.type = capsuleCollider;
+	c.a = a;
+	c.b = b;
+	c.radius = radius;
+	return c;
+}
+
+Collider makeField(int field)
+{
+	Collider c;
+	c.type = sdfCollider;
+	c.field = field;
+	return c;
+}
+
+
+// scalar tests, used for the response and anything off the batch path
+float fieldSample(const SignedDistanceField &field, ivec3 cell)
+{
+	cell = clamp(cell, ivec3(0), field.resolution - 1);
+	return field.distances[(cell.z * field.resolution.y + cell.y) * field.resolution.x + cell.x];
+}
+
+float sampleField(const SignedDistanceField &field, vec3 p)
+{
+	vec3 grid = (p - field.origin) / field.cellSize;
+	ivec3 cell = ivec3(floor(grid));
+	vec3 t = grid - vec3(cell);
+
+	float	c00 = mix(fieldSample(field, cell), fieldSample(field, cell + ivec3(1, 0, 0)), t.x),
+			c10 = mix(fieldSample(field, cell + ivec3(0, 1, 0)), fieldSample(field, cell + ivec3(1, 1, 0)), t.x),
+			c01 = mix(fieldSample(field, cell + ivec3(0, 0, 1)), fieldSample(field, cell + ivec3(1, 0, 1)), t.x),
+			c11 = mix(fieldSample(field, cell + ivec3(0, 1, 1)), fieldSample(field, cell + ivec3(1, 1, 1)), t.x);
+	return mix(mix(c00, c10, t.y), mix(c01, c11, t.y), t.z);
+}
+
+// the point of triangle abc closest to p, by the region of the triangle p projects into
+vec3 closestOnTriangle(vec3 p, vec3 a, vec3 b, vec3 c)
+{
+	vec3	ab = b - a,
+			ac = c - a,
+			ap = p - a;
+	float	d1 = dot(ab, ap),
+			d2 = dot(ac, ap);
+	if (d1 <= 0.f && d2 <= 0.f)
+		return a;
+
+	vec3 bp = p - b;
+	float	d3 = dot(ab, bp),
+			d4 = dot(ac, bp);
+	if (d3 >= 0.f && d4 <= d3)
+		return b;
+
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+		return a + d1 / (d1 - d3) * ab;
+
+	vec3 cp = p - c;
+	float	d5 = dot(ab, cp),
+			d6 = dot(ac, cp);
+	if (d6 >= 0.f && d5 <= d6)
+		return c;
+
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+		return a + d2 / (d2 - d6) * ac;
+
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f)
+		return b + (d4 - d3) / ((d4 - d3) + (d5 - d6)) * (c - b);
+
+	float denominator = 1.f / (va + vb + vc);
+	return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+// the solid angle abc covers seen from p, signed by the winding
+float solidAngle(vec3 p, vec3 a, vec3 b, vec3 c)
+{
+	a -= p;
+	b -= p;
+	c -= p;
+	float	la = length(a),
+			lb = length(b),
+			lc = length(c);
+	return 2.f * atan2(dot(a, cross(b, c)), la * lb * lc + dot(a, b) * lc + dot(b, c) * la + dot(c, a) * lb);
+}
+
+void bakeField(SignedDistanceField &field, const std::vector<vec3> &positions, const std::vector<unsigned int> &triangles, int resolution)
+{
+	vec3	lower = positions[0],
+			upper = lower;
+	for (unsigned int i = 1; i < positions.size(); i++)
+	{
+		lower = min(lower, positions[i]);
+		upper = max(upper, positions[i]);
+	}
+	vec3 size = upper - lower;
+	field.cellSize = max(max(size.x, max(size.y, size.z)) / (float)max(resolution - 1, 1), 1e-6f);
+	field.origin = lower - (float)fieldBorder * field.cellSize;
+	field.resolution = ivec3(size / field.cellSize + .5f) + 1 + 2 * fieldBorder;
+	field.distances.resize((size_t)field.resolution.x * field.resolution.y * field.resolution.z);
+
+	// every sample against every triangle, baked once when the scene loads
+	const ivec3 r = field.resolution;
+	const int	sampleCount = (int)field.distances.size(),
+				triangleCount = (int)triangles.size() / 3;
+	#pragma omp parallel for
+	for (int i = 0; i < sampleCount; i++)
+	{
+		vec3 p = field.origin + field.cellSize * vec3(i % r.x, (i / r.x) % r.y, i / (r.x * r.y));
+		float	nearest = FLT_MAX,
+				winding = 0.f;
+		for (int t = 0; t < triangleCount; t++)
+		{
+			vec3	a = positions[triangles[3 * t]],
+					b = positions[triangles[3 * t + 1]],
+					c = positions[triangles[3 * t + 2]],
+					d = p - closestOnTriangle(p, a, b, c);
+			nearest = min(nearest, dot(d, d));
+			winding += solidAngle(p, a, b, c);
+		}
+		// a whole turn is 4 pi, either way round depending on how the faces wind
+		field.distances[i] = abs(winding) > twoPI ? -sqrt(nearest) : sqrt(nearest);
+	}
+	measureFieldSlope(field);
+}
+
+void measureFieldSlope(SignedDistanceField &field)
+{
+	const ivec3 r = field.resolution;
+	float steepest = 0.f;
+	for (int z = 0; z < r.z; z++)
+		for (int y = 0; y < r.y; y++)
+			for (int x = 0; x < r.x; x++)
+			{
+				float d = fieldSample(field, ivec3(x, y, z));
+				if (x + 1 < r.x)	steepest = max(steepest, abs(fieldSample(field, ivec3(x + 1, y, z)) - d));
+				if (y + 1 < r.y)	steepest = max(steepest, abs(fieldSample(field, ivec3(x, y + 1, z)) - d));
+				if (z + 1 < r.z)	steepest = max(steepest, abs(fieldSample(field, ivec3(x, y, z + 1)) - d));
+			}
+
+	// every partial derivative of the interpolation is a blend of differences along its
+	// axis, so the gradient is at most sqrt 3 times the steepest of them
+	field.lipschitz = field.cellSize > 0.f ? max(sqrt(3.f) * steepest / field.cellSize, 1.f) : 1.f;
+}
+
+float colliderDistance(const ColliderSet &set, const Collider &collider, vec3 p, vec3 &normal)
+{
+	switch (collider.type)
+	{
+		case (sphereCollider):
+		{
+			vec3 d = p - collider.center;
+			float len = length(d);
+			normal = len > 0.f ? d / len : vec3(0.f, 1.f, 0.f);
+			return len - collider.radius;
+		}
+		case (boxCollider):
+		{
+			vec3	local = transpose(collider.axes) * (p - collider.center),
+					q = abs(local) - collider.halfExtents;
+			float	outside = length(max(q, 0.f)),
+					inside = min(max(q.x, max(q.y, q.z)), 0.f);
+			vec3 localNormal;
+			if (outside > 0.f)
+				localNormal = max(q, 0.f) * sign(local) / outside;
+			else if (q.x >= q.y && q.x >= q.z)
+				localNormal = vec3(local.x < 0.f ? -1.f : 1.f, 0.f, 0.f);
+			else if (q.y >= q.z)
+				localNormal = vec3(0.f, local.y < 0.f ? -1.f : 1.f, 0.f);
+			else
+				localNormal = vec3(0.f, 0.f, local.z < 0.f ? -1.f : 1.f);
+			normal = collider.axes * localNormal;
+			return outside + inside;
+		}
+		case (capsuleCollider):
+		{
+			vec3	ab = collider.b - collider.a;
+			float	t = clamp(dot(p - collider.a, ab) / dot(ab, ab), 0.f, 1.f);
+			vec3	d = p - (collider.a + t * ab);
+			float	len = length(d);
+			normal = len > 0.f ? d / len : vec3(0.f, 1.f, 0.f);
+			return len - collider.radius;
+		}
+		case (sdfCollider):
+		{
+			const SignedDistanceField &field = set.fields[collider.field];
+			float h = .5f * field.cellSize;
+			vec3 gradient(	sampleField(field, p + vec3(h, 0.f, 0.f)) - sampleField(field, p - vec3(h, 0.f, 0.f)),
+							sampleField(field, p + vec3(0.f, h, 0.f)) - sampleField(field, p - vec3(0.f, h, 0.f)),
+							sampleField(field, p + vec3(0.f, 0.f, h)) - sampleField(field, p - vec3(0.f, 0.f, h)));
+			float len = length(gradient);
+			normal = len > 0.f ? gradient / len : vec3(0.f, 1.f, 0.f);
+			return sampleField(field, p);
+		}
+		default:
+			normal = vec3(0.f, 1.f, 0.f);
+			return 1.f;
+	}
+}
+
+// conservative advancement, the surface is at least the distance over the lipschitz
+// bound away so stepping by that can not jump over the collider. the analytic shapes
+// are exact distances, a field's interpolation may change faster than the distance.
+// returns the time of impact or -1
+float sweepCollider(const ColliderSet &set, const Collider &collider, vec3 from, vec3 to)
+{
+	vec3 step = to - from, normal;
+	float	bound = collider.type == sdfCollider ? set.fields[collider.field].lipschitz : 1.f,
+			travel = length(step) * bound,
+			t = 0.f;
+	// already touching at the start, the response at the end handles it. stopping it here
+	// would pin a mass sliding along the surface in place
+	if (colliderDistance(set, collider, from, normal) < colliderMargin)
+		return -1.f;
+	for (int i = 0; i < sweepIterations; i++)
+	{
+		float dist = colliderDistance(set, collider, from + t * step, normal);
+		if (dist < colliderMargin)
+			return t;
+		if (travel == 0.f)
+			return -1.f;
+		t += dist / travel;
+		if (t >= 1.f)
+			return -1.f;
+	}
+	return -1.f;
+}
+
+
+// batch tests, four masses per instruction over the structure of arrays copy
+void sphereDistances(const Collider &c, const float *x, const float *y, const float *z, float *out, int count)
+{
+	const __m128	cx = _mm_set1_ps(c.center.x),
+					cy = _mm_set1_ps(c.center.y),
+					cz = _mm_set1_ps(c.center.z),
+					radius = _mm_set1_ps(c.radius);
+
+	#pragma omp parallel for
+	for (int i = 0; i < count; i += 4)
+	{
+		__m128	dx = _mm_sub_ps(_mm_loadu_ps(x + i), cx),
+				dy = _mm_sub_ps(_mm_loadu_ps(y + i), cy),
+				dz = _mm_sub_ps(_mm_loadu_ps(z + i), cz),
+				len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		_mm_storeu_ps(out + i, _mm_sub_ps(_mm_sqrt_ps(len2), radius));
+	}
+}
+
+void capsuleDistances(const Collider &c, const float *x, const float *y, const float *z, float *out, int count)
+{
+	vec3 ab = c.b - c.a;
+	const __m128	ax = _mm_set1_ps(c.a.x),
+					ay = _mm_set1_ps(c.a.y),
+					az = _mm_set1_ps(c.a.z),
+					abx = _mm_set1_ps(ab.x),
+					aby = _mm_set1_ps(ab.y),
+					abz = _mm_set1_ps(ab.z),
+					inverseLength2 = _mm_set1_ps(1.f / dot(ab, ab)),
+					zero = _mm_setzero_ps(),
+					one = _mm_set1_ps(1.f),
+					radius = _mm_set1_ps(c.radius);
+
+	#pragma omp parallel for
+	for (int i = 0; i < count; i += 4)
+	{
+		__m128	dx = _mm_sub_ps(_mm_loadu_ps(x + i), ax),
+				dy = _mm_sub_ps(_mm_loadu_ps(y + i), ay),
+				dz = _mm_sub_ps(_mm_loadu_ps(z + i), az),
+				along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, abx), _mm_mul_ps(dy, aby)), _mm_mul_ps(dz, abz)),
+				t = _mm_min_ps(_mm_max_ps(_mm_mul_ps(along, inverseLength2), zero), one);
+		dx = _mm_sub_ps(dx, _mm_mul_ps(t, abx));
+		dy = _mm_sub_ps(dy, _mm_mul_ps(t, aby));
+		dz = _mm_sub_ps(dz, _mm_mul_ps(t, abz));
+		__m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		_mm_storeu_ps(out + i, _mm_sub_ps(_mm_sqrt_ps(len2), radius));
+	}
+}
+
+void boxDistances(const Collider &c, const float *x, const float *y, const float *z, float *out, int count)
+{
+	__m128 axis[3][3];
+	for (int col = 0; col < 3; col++)
+		for (int row = 0; row < 3; row++)
+			axis[col][row] = _mm_set1_ps(c.axes[col][row]);
+	const __m128	cx = _mm_set1_ps(c.center.x),
+					cy = _mm_set1_ps(c.center.y),
+					cz = _mm_set1_ps(c.center.z),
+					hx = _mm_set1_ps(c.halfExtents.x),
+					hy = _mm_set1_ps(c.halfExtents.y),
+					hz = _mm_set1_ps(c.halfExtents.z),
+					absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)),
+					zero = _mm_setzero_ps();
+
+	#pragma omp parallel for
+	for (int i = 0; i < count; i += 4)
+	{
+		__m128	dx = _mm_sub_ps(_mm_loadu_ps(x + i), cx),
+				dy = _mm_sub_ps(_mm_loadu_ps(y + i), cy),
+				dz = _mm_sub_ps(_mm_loadu_ps(z + i), cz);
+
+		// into box space, |local| - half extents
+		__m128 q[3];
+		__m128 half[3] = { hx, hy, hz };
+		for (int col = 0; col < 3; col++)
+		{
+			__m128 local = _mm_add_ps(_mm_add_ps(	_mm_mul_ps(dx, axis[col][0]),
+													_mm_mul_ps(dy, axis[col][1])),
+													_mm_mul_ps(dz, axis[col][2]));
+			q[col] = _mm_sub_ps(_mm_and_ps(local, absMask), half[col]);
+		}
+
+		__m128	ox = _mm_max_ps(q[0], zero),
+				oy = _mm_max_ps(q[1], zero),
+				oz = _mm_max_ps(q[2], zero),
+				outside = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, ox), _mm_mul_ps(oy, oy)), _mm_mul_ps(oz, oz))),
+				inside = _mm_min_ps(_mm_max_ps(q[0], _mm_max_ps(q[1], q[2])), zero);
+		_mm_storeu_ps(out + i, _mm_add_ps(outside, inside));
+	}
+}
+
+void fieldDistances(const SignedDistanceField &field, const float *x, const float *y, const float *z, float *out, int count)
+{
+	// trilinear lookups are gathers, nothing to gain from packing them
+	#pragma omp parallel for
+	for (int i = 0; i < count; i++)
+		out[i] = sampleField(field, vec3(x[i], y[i], z[i]));
+}
+
+void beginColliderStep(ColliderSet &set, const std::vector<Mass> &masses)
+{
+	if (set.colliders.empty())
+		return;
+	const int massCount = (int)masses.size();
+	set.start.resize(massCount);
+	#pragma omp parallel for
+	for (int i = 0; i < massCount; i++)
+		set.start[i] = masses[i].position;
+}
+
+void collideColliders(std::vector<Mass> &masses, ColliderSet &set)
+{
+	if (set.colliders.empty() || masses.empty())
+		return;
+
+	// rounded up to whole packs of four, the tail past massCount is tested but never read
+	const int	massCount = (int)masses.size(),
+				padded = (massCount + 3) & ~3;
+	set.x.resize(padded);
+	set.y.resize(padded);
+	set.z.resize(padded);
+	set.distance.resize(padded);
+	set.travel.resize(massCount);
+
+	// from the snapshot, the plane may have stopped a mass so its velocity no longer says
+	// how it moved. without one, as on a scene's first step, nothing is swept
+	if (set.start.size() != masses.size())
+		beginColliderStep(set, masses);
+	#pragma omp parallel for
+	for (int i = 0; i < massCount; i++)
+	{
+		const Mass &m = masses[i];
+		set.x[i] = m.position.x;
+		set.y[i] = m.position.y;
+		set.z[i] = m.position.z;
+		set.travel[i] = length(m.position - set.start[i]);
+	}
+
+	for (unsigned int c = 0; c < set.colliders.size(); c++)
+	{
+		const Collider &collider = set.colliders[c];
+		switch (collider.type)
+		{
+			case (sphereCollider):
+				sphereDistances(collider, &set.x[0], &set.y[0], &set.z[0], &set.distance[0], padded);
+				break;
+			case (boxCollider):
+				boxDistances(collider, &set.x[0], &set.y[0], &set.z[0], &set.distance[0], padded);
+				break;
+			case (capsuleCollider):
+				capsuleDistances(collider, &set.x[0], &set.y[0], &set.z[0], &set.distance[0], padded);
+				break;
+			case (sdfCollider):
+				fieldDistances(set.fields[collider.field], &set.x[0], &set.y[0], &set.z[0], &set.distance[0], massCount);
+				break;
+		}
+
+		// only the few masses in contact go on to the scalar response. anything that
+		// travelled further than its distance may have passed through and gets swept
+		const float bound = collider.type == sdfCollider ? set.fields[collider.field].lipschitz : 1.f;
+		set.touching.clear();
+		for (int i = 0; i < massCount; i++)
+			if (set.distance[i] < max(colliderMargin, set.travel[i] * bound) && !masses[i].fixed)
+				set.touching.push_back(i);
+
+		const int touchingCount = (int)set.touching.size();
+		#pragma omp parallel for
+		for (int t = 0; t < touchingCount; t++)
+		{
+			unsigned int i = set.touching[t];
+			Mass &m = masses[i];
+
+			// clamp to the time of impact when the step ran into the collider
+			if (set.distance[i] >= colliderMargin)
+			{
+				float impact = sweepCollider(set, collider, set.start[i], m.position);
+				if (impact < 0.f)
+					continue;
+				m.position = mix(set.start[i], m.position, impact);
+			}
+
+			vec3 normal;
+			float dist = colliderDistance(set, collider, m.position, normal);
+
+			// back onto the surface
+			if (dist < 0.f)
+				m.position -= dist * normal;
+
+			float approach = dot(m.velocity, normal);
+			if (approach < 0.f)
+			{
+				// coulomb friction, the tangential change is bounded by the normal change
+				vec3 tangent = m.velocity - approach * normal;
+				float	tangentSpeed = length(tangent),
+						keep = tangentSpeed > 0.f ? max(1.f - collider.friction * -approach / tangentSpeed, 0.f) : 0.f;
+				m.velocity = keep * tangent - collider.restitution * approach * normal;
+			}
+
+			set.x[i] = m.position.x;
+			set.y[i] = m.position.y;
+			set.z[i] = m.position.z;
+		}
+	}
+}
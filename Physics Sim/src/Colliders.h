@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Header.h"
+
+#define sphereCollider		0
+#define boxCollider			1
+#define capsuleCollider		2
+#define sdfCollider			3
+
+#define colliderMargin		.002f	// masses closer than this count as touching
+#define sweepIterations		32
+#define fieldBorder			3		// samples a baked field reaches past the mesh on every side
+
+struct Collider
+{
+	Collider() :	type(sphereCollider),
+					center(glm::vec3(0.f, 0.f, 0.f)),
+					axes(glm::mat3(1.f)),
+					halfExtents(glm::vec3(.1f, .1f, .1f)),
+					a(glm::vec3(0.f, 0.f, 0.f)),
+					b(glm::vec3(0.f, 0.f, 0.f)),
+					radius(.1f),
+					field(0),
+					friction(.5f),
+					restitution(0.f) { }
+	int type;
+	glm::vec3 center;			// spheres and boxes
+	glm::mat3 axes;				// box orientation, columns are the box axes
+	glm::vec3 halfExtents;
+	glm::vec3 a, b;				// capsule segment
+	float radius;				// spheres and capsules
+	int field;					// index into ColliderSet::fields
+	float friction;				// coulomb coefficient against the normal impulse
+	float restitution;			// 0 sticks to the surface, 1 bounces back fully
+};
+
+// distances sampled on a regular grid, trilinearly interpolated between samples
+struct SignedDistanceField
+{
+	SignedDistanceField() : cellSize(0.f), lipschitz(1.f) { }
+	glm::ivec3 resolution;
+	glm::vec3 origin;
+	float cellSize;
+	std::vector<float> distances;	// x fastest, then y, then z
+	float lipschitz;				// how much faster than the distance the interpolation may change
+};
+
+struct ColliderSet
+{
+	std::vector<Collider> colliders;
+	std::vector<SignedDistanceField> fields;
+
+	// scratch for the batch pass, masses in structure of arrays form
+	std::vector<float> x, y, z, distance, travel;
+	std::vector<glm::vec3> start;		// positions before the substep, from beginColliderStep
+	std::vector<unsigned int> touching;
+};
+
+Collider makeSphere(glm::vec3 center, float radius);
+Collider makeBox(glm::vec3 center, glm::vec3 halfExtents, glm::mat3 axes);
+Collider makeCapsule(glm::vec3 a, glm::vec3 b, float radius);
+Collider makeField(int field);
+
+float sampleField(const SignedDistanceField &field, glm::vec3 p);
+
+// distances to a closed triangle mesh on a grid around it, negative inside. resolution
+// samples along the longest side of the mesh's bounds. inside is where the triangles
+// wind around the sample, so a mesh with small holes still has one
+void bakeField(SignedDistanceField &field, const std::vector<glm::vec3> &positions,
+			   const std::vector<unsigned int> &triangles, int resolution);
+
+// a bound on the trilinear interpolation's gradient, from the largest difference between
+// neighbouring samples. call it whenever the distances change
+void measureFieldSlope(SignedDistanceField &field);
+
+float colliderDistance(const ColliderSet &set, const Collider &collider, glm::vec3 p, glm::vec3 &normal);
+float sweepCollider(const ColliderSet &set, const Collider &collider, glm::vec3 from, glm::vec3 to);
+// where the masses are before the spring kernel moves them, collideColliders sweeps
+// from there to where they end up
+void beginColliderStep(ColliderSet &set, const std::vector<Mass> &masses);
+void collideColliders(std::vector<Mass> &masses, ColliderSet &set);
@@ -0,0 +1,258 @@
+#include "Collision.h"
+#include <omp.h>
+
+using namespace glm;
+
+// scratch, one set per thread so batch runs collide side by side. parallel loops reach
+// it through references taken on the calling thread, never by name
+thread_local SpatialHash selfCollisionGrid;
+thread_local std::vector<vec3>	selfVelocityChange,
+								selfPositionChange;
+thread_local std::vector<VertexTriangleContact> vertexTriangles;
+thread_local std::vector<EdgeEdgeContact> edgeEdges;
+thread_local std::vector<vec3>	contactVelocityChange,
+								contactPositionChange;
+thread_local std::vector<unsigned int> contactCount;
+
+ivec3 cellOf(vec3 position, float cellSize)
+{
+	return ivec3(floor(position / cellSize));
+}
+
+unsigned int hashCell(ivec3 cell, unsigned int tableSize)
+{
+	// large primes from Teschner et al. table size is always a power of 2
+	return ((unsigned int)cell.x * 73856093u ^
+			(unsigned int)cell.y * 19349663u ^
+			(unsigned int)cell.z * 83492791u) & (tableSize - 1);
+}
+
+void buildSpatialHash(SpatialHash &grid, const std::vector<Mass> &masses, float cellSize)
+{
+	const int massCount = (int)masses.size();
+	const int threads = omp_get_max_threads();
+
+	unsigned int tableSize = 1;
+	while (tableSize < masses.size())
+		tableSize <<= 1;
+
+	grid.cellSize = cellSize;
+	grid.tableSize = tableSize;
+	grid.keys.resize(massCount);
+	grid.sorted.resize(massCount);
+	grid.sortedPositions.resize(massCount);
+	grid.cellStart.resize(tableSize + 1);
+	grid.histogram.assign(tableSize * threads, 0);
+
+	// parallel counting sort. every thread owns a contiguous block of masses and its own
+	// column of the histogram so the result is identical to a serial stable sort
+	#pragma omp parallel num_threads(threads)
+	{
+		const int	thread = omp_get_thread_num(),
+					threadCount = omp_get_num_threads(),
+					begin = (int)((long long)massCount * thread / threadCount),
+					end = (int)((long long)massCount * (thread + 1) / threadCount);
+
+		for (int i = begin; i < end; i++)
+		{
+			unsigned int key = hashCell(cellOf(masses[i].position, cellSize), tableSize);
+			grid.keys[i] = key;
+			grid.histogram[key * threads + thread]++;
+		}
+		#pragma omp barrier
+
+		// turn each cell's per thread counts into offsets within the cell
+		#pragma omp for
+		for (int c = 0; c < (int)tableSize; c++)
+		{
+			unsigned int sum = 0;
+			for (int t = 0; t < threadCount; t++)
+			{
+				unsigned int count = grid.histogram[c * threads + t];
+				grid.histogram[c * threads + t] = sum;
+				sum += count;
+			}
+			grid.cellStart[c] = sum;
+		}
+
+		#pragma omp single
+		{
+			unsigned int offset = 0;
+			for (unsigned int c = 0; c < tableSize; c++)
+			{
+				unsigned int count = grid.cellStart[c];
+				grid.cellStart[c] = offset;
+				offset += count;
+			}
+			grid.cellStart[tableSize] = offset;
+		}
+
+		for (int i = begin; i < end; i++)
+		{
+			unsigned int key = grid.keys[i];
+			unsigned int slot = grid.cellStart[key] + grid.histogram[key * threads + thread]++;
+			grid.sorted[slot] = i;
+			grid.sortedPositions[slot] = masses[i].position;
+		}
+	}
+}
+
+void selfCollision(std::vector<Mass> &masses, float thickness)
+{
+	SpatialHash &grid = selfCollisionGrid;
+	std::vector<vec3>	&velocityChange = selfVelocityChange,
+						&positionChange = selfPositionChange;
+	// cells twice the thickness wide mean anything in range is inside the 2x2x2 block
+	// of cells around the mass, 8 buckets to walk instead of 27
+	buildSpatialHash(grid, masses, 2.f * thickness);
+
+	const int massCount = (int)masses.size();
+	velocityChange.resize(massCount);
+	positionChange.resize(massCount);
+
+	// jacobi style response, every mass only writes its own correction
+	// masses are visited in cell order so consecutive queries reuse the same buckets
+	#pragma omp parallel for
+	for (int s = 0; s < massCount; s++)
+	{
+		const unsigned int i = grid.sorted[s];
+		const Mass &m = masses[i];
+		vec3	dv(0.f, 0.f, 0.f),
+				dx(0.f, 0.f, 0.f);
+
+		if (!m.fixed)
+		{
+			vec3 scaled = m.position / grid.cellSize;
+			ivec3	cell = ivec3(floor(scaled)),
+					// step towards whichever half of the cell the mass sits in. the fraction
+					// rounds to 1 just below a cell boundary, which is still the upper half
+					step = ivec3(min(2.f * (scaled - floor(scaled)), 1.f)) * 2 - 1;
+			unsigned int visited[8];
+			int visitedCount = 0;
+
+			for (int n = 0; n < 8; n++)
+			{
+				ivec3 offset((n & 1) ? step.x : 0, (n & 2) ? step.y : 0, (n & 4) ? step.z : 0);
+				unsigned int key = hashCell(cell + offset, grid.tableSize);
+
+				// neighbouring cells can hash to the same bucket, only walk it once
+				bool seen = false;
+				for (int v = 0; v < visitedCount && !seen; v++)
+					seen = visited[v] == key;
+				if (seen)
+					continue;
+				visited[visitedCount++] = key;
+
+				for (unsigned int k = grid.cellStart[key]; k < grid.cellStart[key + 1]; k++)
+				{
+					unsigned int j = grid.sorted[k];
+					vec3 delta = m.position - grid.sortedPositions[k];
+					float dist2 = dot(delta, delta);
+					if (j == i || dist2 >= thickness * thickness || dist2 == 0.f)
+						continue;
+
+					const Mass &other = masses[j];
+					float	dist = sqrt(dist2),
+							// fixed masses behave as if infinitely heavy
+							share = other.fixed ? 1.f : other.mass / (m.mass + other.mass);
+					vec3 normal = delta / dist;
+
+					// cancel the approaching part of the relative velocity
+					float approach = dot(m.velocity - other.velocity, normal);
+					if (approach < 0.f)
+						dv -= approach * share * normal;
+
+					// and push the pair back out to the thickness radius
+					dx += (thickness - dist) * share * normal;
+				}
+			}
+		}
+
+		velocityChange[i] = dv;
+		positionChange[i] = dx;
+	}
+
+	#pragma omp parallel for
+	for (int i = 0; i < massCount; i++)
+	{
+		masses[i].velocity += velocityChange[i];
+		masses[i].position += positionChange[i];
+	}
+}
+
+// weights are the barycentric share of each mass in its side of the contact, negative for
+// the side the normal points away from. fixed masses never move. each contact is solved as
+// if it were alone and only added up here, the masses take the mean once all are in
+void resolveContact(const std::vector<Mass> &masses, const unsigned int ids[4], const float weights[4], vec3 normal, float depth,
+					std::vector<vec3> &velocityChange, std::vector<vec3> &positionChange, std::vector<unsigned int> &count)
+{
+	float	inverseMass[4],
+			effective = 0.f,
+			approach = 0.f;
+	for (int k = 0; k < 4; k++)
+	{
+		const Mass &m = masses[ids[k]];
+		inverseMass[k] = m.fixed ? 0.f : 1.f / m.mass;
+		effective += weights[k] * weights[k] * inverseMass[k];
+		approach += weights[k] * dot(m.velocity, normal);
+	}
+	if (effective == 0.f)
+		return;
+
+	// impulse cancels the approaching velocity, the push restores the thickness
+	float	impulse = approach < 0.f ? -approach / effective : 0.f,
+			push = depth / effective;
+	for (int k = 0; k < 4; k++)
+	{
+		velocityChange[ids[k]] += weights[k] * inverseMass[k] * impulse * normal;
+		positionChange[ids[k]] += weights[k] * inverseMass[k] * push * normal;
+		count[ids[k]]++;
+	}
+}
+
+void meshCollision(std::vector<Mass> &masses, const TriangleMesh &mesh, BVH &bvh, float thickness)
+{
+	std::vector<vec3>	&velocityChange = contactVelocityChange,
+						&positionChange = contactPositionChange;
+	std::vector<unsigned int> &count = contactCount;
+	const int massCount = (int)masses.size();
+
+	updateCandidates(bvh, masses, mesh, thickness);
+	vertexTriangleContacts(bvh, masses, mesh, thickness, vertexTriangles);
+	edgeEdgeContacts(bvh, masses, mesh, thickness, edgeEdges);
+	if (vertexTriangles.empty() && edgeEdges.empty())
+		return;
+
+	// pushes added one after another overshoot where contacts crowd, and the energy they put in
+	// comes back out of the springs. every mass takes the mean of its contacts' instead, none
+	// is moved further than the thickness
+	velocityChange.assign(massCount, vec3(0.f));
+	positionChange.assign(massCount, vec3(0.f));
+	count.assign(massCount, 0);
+	for (unsigned int i = 0; i < vertexTriangles.size(); i++)
+	{
+		const VertexTriangleContact &c = vertexTriangles[i];
+		const unsigned int *tri = &mesh.triangles[3 * c.triangle];
+		unsigned int ids[4] = { c.vertex, tri[0], tri[1], tri[2] };
+		float weights[4] = { 1.f, -c.barycentric.x, -c.barycentric.y, -c.barycentric.z };
+		resolveContact(masses, ids, weights, c.normal, thickness - c.distance, velocityChange, positionChange, count);
+	}
+	for (unsigned int i = 0; i < edgeEdges.size(); i++)
+	{
+		const EdgeEdgeContact &c = edgeEdges[i];
+		const Edge	&a = mesh.edges[c.edgeA],
+					&b = mesh.edges[c.edgeB];
+		unsigned int ids[4] = { a.m1, a.m2, b.m1, b.m2 };
+		float weights[4] = { 1.f - c.s, c.s, c.t - 1.f, -c.t };
+		resolveContact(masses, ids, weights, c.normal, thickness - c.distance, velocityChange, positionChange, count);
+	}
+
+	#pragma omp parallel for
+	for (int i = 0; i < massCount; i++)
+	{
+		if (count[i] == 0)
+			continue;
+		masses[i].velocity += velocityChange[i] / (float)count[i];
+		masses[i].position += positionChange[i] / (float)count[i];
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Header.h"
+#include "BVH.h"
+
+// uniform grid hashed into a fixed table, rebuilt from scratch every substep
+// masses are counting sorted by cell so a neighbour query walks contiguous memory
+struct SpatialHash
+{
+	float cellSize;
+	unsigned int tableSize;
+	std::vector<unsigned int>	keys,			// cell of every mass
+								cellStart,		// tableSize + 1 offsets into sorted
+								sorted,			// mass indices in cell order
+								histogram;		// per cell, per thread counts
+	std::vector<glm::vec3>		sortedPositions;
+};
+
+void buildSpatialHash(SpatialHash &grid, const std::vector<Mass> &masses, float cellSize);
+void selfCollision(std::vector<Mass> &masses, float thickness);
+void meshCollision(std::vector<Mass> &masses, const TriangleMesh &mesh, BVH &bvh, float thickness);
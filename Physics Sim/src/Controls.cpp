@@ -25,7 +25,19 @@ vec3	camUp	= defaultCamUp,
 		xRotationalAxis(1.f, 0.f, 0.f);
 
 
-void passBasicUniforms(GLuint program)
+GLuint	cameraBuffer;
+
+void generateCameraBuffer()
+{
+	glGenBuffers(1, &cameraBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, cameraBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(mat4), NULL, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, cameraBinding, cameraBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+// once a frame, every program then reads the same matrices out of the camera block
+void updateCamera()
 {
 	mat4	modelview = lookAt(camLoc * zoom, camCent, camUp),
 			projection = perspective(FOV, aspectRatio, zNear, zFar);
@@ -33,8 +45,10 @@ void passBasicUniforms(GLuint program)
 	mat4	rotationX  = rotate(identity , rotate_x  * PI / 180.0f, xRotationalAxis);
 			modelview *= rotate(rotationX, rotate_y  * PI / 180.0f, yRotationalAxis);
 
-	glUniformMatrix4fv(glGetUniformLocation(program, "modelview"), 1, GL_FALSE, value_ptr(modelview));
-	glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, value_ptr(projection));
+	glBindBuffer(GL_UNIFORM_BUFFER, cameraBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(mat4), value_ptr(modelview));
+	glBufferSubData(GL_UNIFORM_BUFFER, sizeof(mat4), sizeof(mat4), value_ptr(projection));
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 
@@ -57,6 +71,63 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 			simulation = !simulation;
 			break;
 
+		// cloth as a shaded surface or as its springs
+		case (GLFW_KEY_C):
+			clothSurface = !clothSurface;
+			break;
+
+		// render at the display's rate, interpolating the fixed rate physics
+		case (GLFW_KEY_I):
+			decoupledRendering = !decoupledRendering;
+			std::cout << "Rendering " << (decoupledRendering ? "decoupled from" : "locked to") << " physics" << std::endl;
+			break;
+
+		// masses colored by speed or by the strain of their springs
+		case (GLFW_KEY_V):
+			massColoring = massColoring == speedColoring ? strainColoring : speedColoring;
+			std::cout << "Coloring masses by " << (massColoring == speedColoring ? "speed" : "strain") << std::endl;
+			break;
+
+		// toggle spring tearing
+		case (GLFW_KEY_T):
+			solver.tearThreshold = solver.tearThreshold > 0.f ? 0.f : defaultTearThreshold;
+			std::cout << "Tearing " << (solver.tearThreshold > 0.f ? "on" : "off") << std::endl;
+			break;
+
+
+		// playback speed and seeking, while a recording plays
+		case (GLFW_KEY_UP):
+		case (GLFW_KEY_DOWN):
+			if (!playback)
+				break;
+			playbackSpeed *= key == GLFW_KEY_UP ? 2.f : .5f;
+			std::cout << "Playing at " << playbackSpeed << "x" << std::endl;
+			break;
+		case (GLFW_KEY_R):
+			if (!playback)
+				break;
+			playbackSpeed = -playbackSpeed;
+			std::cout << "Playing " << (playbackSpeed > 0.f ? "forwards" : "backwards") << std::endl;
+			break;
+		case (GLFW_KEY_LEFT):
+			playbackFrame -= seekFrames;
+			break;
+		case (GLFW_KEY_RIGHT):
+			playbackFrame += seekFrames;
+			break;
+		case (GLFW_KEY_HOME):
+			playbackFrame = 0.0;
+			break;
+
+
+		// save the simulation, or go back to the last save
+		case (GLFW_KEY_F5):
+			checkpointSave = true;
+			break;
+		case (GLFW_KEY_F9):
+			checkpointRestore = true;
+			break;
+
 
 		// changing states
 		case (GLFW_KEY_1):
@@ -84,6 +155,31 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 			stateChange = true;
 			zoom = defaultZoom;
 			break;
+		case (GLFW_KEY_6):
+			state = clothDrapeState;
+			stateChange = true;
+			zoom = defaultZoom;
+			break;
+		case (GLFW_KEY_7):
+			state = cubePileState;
+			stateChange = true;
+			zoom = defaultZoom;
+			break;
+		case (GLFW_KEY_8):
+			state = meshState;
+			stateChange = true;
+			zoom = defaultZoom;
+			break;
+		case (GLFW_KEY_9):
+			state = tetState;
+			stateChange = true;
+			zoom = defaultZoom;
+			break;
+		case (GLFW_KEY_0):
+			state = sceneFileState;
+			stateChange = true;
+			zoom = defaultZoom;
+			break;
 
 		
 		// camera movement
@@ -0,0 +1,257 @@
+#include "Export.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+using namespace glm;
+
+// a job holds the frame as the simulation left it
+//
+//	ExportCounts
+//	massCount positions, massCount speeds, massCount fixed flags padded to 4 bytes
+//	springCount * 2 mass indices, springCount strains
+//	triangleCount * 3 mass indices
+struct ExportCounts
+{
+	unsigned int massCount, springCount, triangleCount;
+};
+
+struct ExportFrame
+{
+	ExportCounts counts;
+	const vec3 *positions;
+	const float *speeds;
+	const unsigned char *fixed;
+	const unsigned int *springs;
+	const float *strains;
+	const unsigned int *triangles;
+};
+
+size_t fixedBytes(unsigned int massCount)
+{
+	return (massCount + 3) & ~3u;
+}
+
+size_t jobSize(const ExportCounts &counts)
+{
+	return	sizeof(counts) +
+			counts.massCount * (sizeof(vec3) + sizeof(float)) + fixedBytes(counts.massCount) +
+			counts.springCount * (2 * sizeof(unsigned int) + sizeof(float)) +
+			counts.triangleCount * 3 * sizeof(unsigned int);
+}
+
+ExportFrame readJob(const WriteJob &job)
+{
+	ExportFrame frame;
+	memcpy(&frame.counts, job.data.data(), sizeof(frame.counts));
+	const char *at = job.data.data() + sizeof(frame.counts);
+	frame.positions = (const vec3*)at;			at += frame.counts.massCount * sizeof(vec3);
+	frame.speeds = (const float*)at;			at += frame.counts.massCount * sizeof(float);
+	frame.fixed = (const unsigned char*)at;		at += fixedBytes(frame.counts.massCount);
+	frame.springs = (const unsigned int*)at;	at += frame.counts.springCount * 2 * sizeof(unsigned int);
+	frame.strains = (const float*)at;			at += frame.counts.springCount * sizeof(float);
+	frame.triangles = (const unsigned int*)at;
+	return frame;
+}
+
+
+// formatting, on the writer thread
+
+void appendText(std::vector<char> &out, const char *text)
+{
+	out.insert(out.end(), text, text + strlen(text));
+}
+
+template <typename T>
+void appendValue(std::vector<char> &out, T value)
+{
+	const char *bytes = (const char*)&value;
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+// legacy VTK binary data is big endian
+template <typename T>
+void appendBigEndian(std::vector<char> &out, T value)
+{
+	const char *bytes = (const char*)&value;
+	for (int i = (int)sizeof(T) - 1; i >= 0; i--)
+		out.push_back(bytes[i]);
+}
+
+void formatVTK(std::vector<char> &out, const ExportFrame &frame, unsigned int index)
+{
+	const ExportCounts &counts = frame.counts;
+	char line[256];
+	snprintf(line, sizeof(line), "# vtk DataFile Version 3.0\nPhysics Sim frame %u\nBINARY\nDATASET POLYDATA\nPOINTS %u float\n",
+		index, counts.massCount);
+	appendText(out, line);
+	for (unsigned int i = 0; i < counts.massCount; i++)
+		for (int axis = 0; axis < 3; axis++)
+			appendBigEndian(out, frame.positions[i][axis]);
+
+	snprintf(line, sizeof(line), "\nLINES %u %u\n", counts.springCount, 3 * counts.springCount);
+	appendText(out, line);
+	for (unsigned int i = 0; i < counts.springCount; i++)
+	{
+		appendBigEndian(out, 2);
+		appendBigEndian(out, (int)frame.springs[2 * i]);
+		appendBigEndian(out, (int)frame.springs[2 * i + 1]);
+	}
+
+	if (counts.triangleCount)
+	{
+		snprintf(line, sizeof(line), "\nPOLYGONS %u %u\n", counts.triangleCount, 4 * counts.triangleCount);
+		appendText(out, line);
+		for (unsigned int i = 0; i < counts.triangleCount; i++)
+		{
+			appendBigEndian(out, 3);
+			for (int k = 0; k < 3; k++)
+				appendBigEndian(out, (int)frame.triangles[3 * i + k]);
+		}
+	}
+
+	// cells run lines then polygons, triangles have no strain of their own
+	snprintf(line, sizeof(line), "\nCELL_DATA %u\nSCALARS strain float 1\nLOOKUP_TABLE default\n", counts.springCount + counts.triangleCount);
+	appendText(out, line);
+	for (unsigned int i = 0; i < counts.springCount; i++)
+		appendBigEndian(out, frame.strains[i]);
+	for (unsigned int i = 0; i < counts.triangleCount; i++)
+		appendBigEndian(out, 0.f);
+
+	snprintf(line, sizeof(line), "\nPOINT_DATA %u\nSCALARS speed float 1\nLOOKUP_TABLE default\n", counts.massCount);
+	appendText(out, line);
+	for (unsigned int i = 0; i < counts.massCount; i++)
+		appendBigEndian(out, frame.speeds[i]);
+	appendText(out, "\nSCALARS fixed unsigned_char 1\nLOOKUP_TABLE default\n");
+	out.insert(out.end(), frame.fixed, frame.fixed + counts.massCount);
+	appendText(out, "\n");
+}
+
+void formatPLY(std::vector<char> &out, const ExportFrame &frame, unsigned int index)
+{
+	const ExportCounts &counts = frame.counts;
+	char header[1024];
+	snprintf(header, sizeof(header),
+		"ply\nformat binary_little_endian 1.0\ncomment Physics Sim frame %u\n"
+		"element vertex %u\nproperty float x\nproperty float y\nproperty float z\nproperty float speed\nproperty uchar fixed\n"
+		"element face %u\nproperty list uchar int vertex_indices\n"
+		"element edge %u\nproperty int vertex1\nproperty int vertex2\nproperty float strain\n"
+		"end_header\n",
+		index, counts.massCount, counts.triangleCount, counts.springCount);
+	appendText(out, header);
+
+	for (unsigned int i = 0; i < counts.massCount; i++)
+	{
+		appendValue(out, frame.positions[i]);
+		appendValue(out, frame.speeds[i]);
+		appendValue(out, frame.fixed[i]);
+	}
+	for (unsigned int i = 0; i < counts.triangleCount; i++)
+	{
+		appendValue(out, (unsigned char)3);
+		out.insert(out.end(), (const char*)&frame.triangles[3 * i], (const char*)&frame.triangles[3 * i + 3]);
+	}
+	for (unsigned int i = 0; i < counts.springCount; i++)
+	{
+		appendValue(out, frame.springs[2 * i]);
+		appendValue(out, frame.springs[2 * i + 1]);
+		appendValue(out, frame.strains[i]);
+	}
+}
+
+void writeExportFrame(FILE*, const WriteJob &job, void *context)
+{
+	FrameExporter &exporter = *(FrameExporter*)context;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	ExportFrame frame = readJob(job);
+
+	exporter.formatted.clear();
+	if (exporter.format == vtkExport)
+		formatVTK(exporter.formatted, frame, job.index);
+	else
+		formatPLY(exporter.formatted, frame, job.index);
+
+	char filename[512];
+	snprintf(filename, sizeof(filename), "%s_%05u.%s", exporter.path.c_str(), job.index, exporter.format == vtkExport ? "vtk" : "ply");
+	FILE *file = fopen(filename, "wb");
+	if (file)
+	{
+		fwrite(exporter.formatted.data(), 1, exporter.formatted.size(), file);
+		fclose(file);
+		exporter.bytes += exporter.formatted.size();
+	}
+	else
+		std::cout << "FILE " << filename << " COULD NOT BE OPENED" << std::endl;
+	exporter.writeTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+bool startExport(FrameExporter &exporter, const std::string &path, int format, unsigned int interval)
+{
+	exporter.path = path;
+	exporter.format = format;
+	exporter.interval = interval ? interval : 1;
+	exporter.frames = 0;
+	exporter.bytes = 0;
+	exporter.writeTime = 0.0;
+	openWriter(exporter.writer, NULL, writeExportFrame, &exporter, exportQueue);
+	exporter.exporting = true;
+	return true;
+}
+
+// the copy is all the simulation pays, unless the disk has fallen a whole queue behind
+void exportFrame(FrameExporter &exporter, unsigned int frame, const std::vector<Mass> &masses,
+				 const std::vector<Spring> &springs, const std::vector<unsigned int> &triangles)
+{
+	if (!exporter.exporting || frame % exporter.interval != 0)
+		return;
+
+	WriteJob *job = acquireJob(exporter.writer);
+	ExportCounts counts = { (unsigned int)masses.size(), (unsigned int)springs.size(), (unsigned int)triangles.size() / 3 };
+	job->data.resize(jobSize(counts));
+	job->index = frame;
+	memcpy(job->data.data(), &counts, sizeof(counts));
+	ExportFrame out = readJob(*job);
+
+	const int massCount = (int)counts.massCount,
+			  springCount = (int)counts.springCount;
+	vec3 *positions = (vec3*)out.positions;
+	float *speeds = (float*)out.speeds, *strains = (float*)out.strains;
+	unsigned char *fixed = (unsigned char*)out.fixed;
+	unsigned int *indices = (unsigned int*)out.springs;
+	#pragma omp parallel for
+	for (int i = 0; i < massCount; i++)
+	{
+		positions[i] = masses[i].position;
+		speeds[i] = length(masses[i].velocity);
+		fixed[i] = masses[i].fixed;
+	}
+	#pragma omp parallel for
+	for (int i = 0; i < springCount; i++)
+	{
+		const Spring &s = springs[i];
+		indices[2 * i] = s.m1;
+		indices[2 * i + 1] = s.m2;
+		strains[i] = length(masses[s.m1].position - masses[s.m2].position) / s.restLength - 1.f;
+	}
+	if (!triangles.empty())
+		memcpy((unsigned int*)out.triangles, triangles.data(), triangles.size() * sizeof(unsigned int));
+
+	exporter.frames++;
+	submitJob(exporter.writer, job);
+}
+
+void stopExport(FrameExporter &exporter)
+{
+	if (!exporter.exporting)
+		return;
+	exporter.exporting = false;
+	stopWriter(exporter.writer);
+
+	const AsyncWriter &writer = exporter.writer;
+	std::cout	<< "Exported " << exporter.frames << " frames, " << exporter.bytes / 1024 << " KB in "
+				<< exporter.writeTime << " s on the writer thread" << std::endl
+				<< "  the simulation waited on the disk " << writer.stalls << " times for " << writer.stallTime
+				<< " s, at most " << writer.deepest << " of " << exportQueue << " frames queued" << std::endl;
+}
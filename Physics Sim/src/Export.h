@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Header.h"
+#include "AsyncWriter.h"
+#include <string>
+
+#define vtkExport			0	// legacy VTK polydata, binary
+#define plyExport			1	// binary little endian PLY
+
+#define exportQueue			4	// frames waiting on the disk before the simulation stalls
+
+// every interval'th frame's masses, springs and cloth triangles as files ParaView opens,
+// path_00042.vtk and so on. the main thread only copies the frame into a pooled job, the
+// writer thread formats it and writes the file
+struct FrameExporter
+{
+	FrameExporter() :	exporting(false),
+						interval(1) { }
+	bool exporting;
+	int format;
+	unsigned int interval;
+	std::string path;
+	unsigned int frames;
+
+	// writer thread only
+	std::vector<char> formatted;
+	unsigned long long bytes;
+	double writeTime;			// seconds spent formatting and writing
+
+	AsyncWriter writer;
+};
+
+bool startExport(FrameExporter &exporter, const std::string &path, int format, unsigned int interval);
+void exportFrame(FrameExporter &exporter, unsigned int frame, const std::vector<Mass> &masses,
+				 const std::vector<Spring> &springs, const std::vector<unsigned int> &triangles);
+void stopExport(FrameExporter &exporter);
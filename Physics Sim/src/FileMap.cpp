@@ -0,0 +1,86 @@
+#include "FileMap.h"
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+bool mapFile(FileMap &map, const std::string &filename)
+{
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	LARGE_INTEGER size;
+	if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		std::cout << "FILE " << filename << " COULD NOT BE OPENED" << std::endl;
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	const void *data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (!data)
+	{
+		std::cout << "FILE " << filename << " COULD NOT BE MAPPED" << std::endl;
+		if (mapping)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	map.data = (const unsigned char*)data;
+	map.size = (size_t)size.QuadPart;
+	map.file = file;
+	map.mapping = mapping;
+	return true;
+}
+
+void unmapFile(FileMap &map)
+{
+	if (map.data)
+	{
+		UnmapViewOfFile(map.data);
+		CloseHandle((HANDLE)map.mapping);
+		CloseHandle((HANDLE)map.file);
+	}
+	map = FileMap();
+}
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool mapFile(FileMap &map, const std::string &filename)
+{
+	int descriptor = open(filename.c_str(), O_RDONLY);
+	struct stat info;
+	if (descriptor < 0 || fstat(descriptor, &info) != 0 || info.st_size == 0)
+	{
+		std::cout << "FILE " << filename << " COULD NOT BE OPENED" << std::endl;
+		if (descriptor >= 0)
+			close(descriptor);
+		return false;
+	}
+
+	void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	close(descriptor);		// the mapping keeps the file
+	if (data == MAP_FAILED)
+	{
+		std::cout << "FILE " << filename << " COULD NOT BE MAPPED" << std::endl;
+		return false;
+	}
+
+	map.data = (const unsigned char*)data;
+	map.size = (size_t)info.st_size;
+	return true;
+}
+
+void unmapFile(FileMap &map)
+{
+	if (map.data)
+		munmap((void*)map.data, map.size);
+	map = FileMap();
+}
+#endif
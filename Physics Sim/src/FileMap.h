@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// a whole file mapped read only, pages come in as they are touched
+struct FileMap
+{
+	FileMap() :	data(NULL),
+				size(0),
+				file(NULL),
+				mapping(NULL) { }
+	const unsigned char *data;
+	size_t size;
+	void *file, *mapping;		// platform handles
+};
+
+bool mapFile(FileMap &map, const std::string &filename);
+void unmapFile(FileMap &map);
@@ -18,21 +18,43 @@
 #define boxSpringState		2
 #define clothHangState		3
 #define clothTableState		4
+#define clothDrapeState		5
+#define cubePileState		6
+#define meshState			7	// the mesh given with --obj
+#define tetState			8	// the tetrahedra given with --tet
+#define sceneFileState		9	// the file given with --scene
+
+#define speedColoring		0	// what the masses are colored by
+#define strainColoring		1
 
 #define WINDOW_WIDTH		700
 #define WINDOW_HEIGHT		500
 
+#define defaultPlaneSize	2.f
+#define defaultPlaneHeight	2.f
+
 #define timeStep			10.f				// if timestep = 1, 60 steps/second
 #define stepsPerSecond		(timeStep * 60.f)	// 20 = 1200 steps/second
 
+#define defaultTearThreshold	2.f			// springs break past twice their rest length
+
 #define identity		mat4(1.f)
 #define defaultZoom		2.f
 #define defaultCamUp	vec3(0.f, 1.f, 0.f)
 #define defaultCamLoc	vec3(0.f, .5f, 2.f)
 #define defaultCamCent	vec3(0.f, 0.f, 0.f)
+// every program declares the same Camera block at this binding, so the buffer is bound
+// once for all of them rather than per program
+#define cameraBinding	0
+
+#define seekFrames		60	// a second of recording per seek key
 
 extern int state;
-extern bool stateChange, simulation;
+extern bool stateChange, simulation, clothSurface, decoupledRendering;
+extern int massColoring;
+extern bool playback, checkpointSave, checkpointRestore;
+extern float playbackSpeed;
+extern double playbackFrame;
 
 struct Mass 
 {
@@ -57,9 +79,42 @@ struct Spring
 	float constant;
 };
 
+// what the mass buffer holds per mass. the attribute word packs the fixed flag in bit 0
+// and a diagnostic in [0, 1] into the top 16 bits, the shaders color by it
+struct MassVertex
+{
+	glm::vec3 position;
+	GLuint attributes;
+};
+
+inline GLuint packMassAttributes(bool fixed, float value)
+{
+	float clamped = value < 0.f ? 0.f : (value > 1.f ? 1.f : value);
+	return (GLuint)fixed | ((GLuint)(clamped * 65535.f + .5f) << 16);
+}
+
+struct SolverSettings
+{
+	SolverSettings() :	selfCollision(false),
+						meshCollision(false),
+						thickness(.004f),
+						contactDistance(.2f),
+						tearThreshold(0.f),
+						damping(1.f) { }
+	bool selfCollision;		// mass against mass collision, in place of meshCollision when both are on
+	bool meshCollision;		// vertex against triangle and edge against edge, needs a triangle mesh
+	float thickness;		// closest two masses may get when self colliding
+	float contactDistance;	// closest masses of two different bodies may get
+	float tearThreshold;	// stretch over rest length that breaks a spring, 0 never breaks
+	float damping;			// force against every mass's velocity, 1 is good with a mass of 1
+};
+
+extern SolverSettings solver;
+
 void generateShaders();
 
-void passBasicUniforms(GLuint program);
+void generateCameraBuffer();
+void updateCamera();
 void errorCallback(int error, const char* description);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
@@ -67,4 +122,7 @@ void window_size_callback(GLFWwindow* window, int width, int height);
 void mouse_motion(GLFWwindow* window, double x, double y);
 void printOpenGLVersion(GLenum majorVer, GLenum minorVer, GLenum langVer);
 
-void springSystem(std::vector<Mass> &masses, std::vector<Spring> &springs, float planeHeight, float planeSize);
\ No newline at end of file
+typedef void(*SpringKernel)(std::vector<Mass> &masses, std::vector<Spring> &springs, float planeHeight, float planeSize, float damping);
+
+void springSystem(std::vector<Mass> &masses, std::vector<Spring> &springs, float planeHeight, float planeSize, float damping);
+SpringKernel selectSpringKernel(const std::vector<Mass> &masses, const std::vector<Spring> &springs, float planeSize);
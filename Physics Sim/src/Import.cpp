@@ -0,0 +1,660 @@
+#include "Import.h"
+#include "FileMap.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+using namespace glm;
+
+// text parsing
+
+inline bool isBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool isDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+const char *skipBlanks(const char *at, const char *end)
+{
+	while (at < end && isBlank(*at))
+		at++;
+	return at;
+}
+
+const char *findLineEnd(const char *at, const char *end)
+{
+	const char *found = (const char*)memchr(at, '\n', end - at);
+	return found ? found : end;
+}
+
+// decimal and exponent notation, without strtod's locale or its cost. NULL if no number
+const char *parseFloat(const char *at, const char *end, float &value)
+{
+	static const double powers[] = {	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+										1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	bool negative = false;
+	if (at < end && (*at == '-' || *at == '+'))
+		negative = *at++ == '-';
+
+	// digits past what the mantissa holds only move the exponent
+	unsigned long long mantissa = 0;
+	int exponent = 0, digits = 0;
+	for (; at < end && isDigit(*at); at++, digits++)
+	{
+		if (mantissa < 100000000000000000ull)
+			mantissa = mantissa * 10 + (*at - '0');
+		else
+			exponent++;
+	}
+	if (at < end && *at == '.')
+	{
+		for (at++; at < end && isDigit(*at); at++, digits++)
+		{
+			if (mantissa < 100000000000000000ull)
+			{
+				mantissa = mantissa * 10 + (*at - '0');
+				exponent--;
+			}
+		}
+	}
+	if (!digits)
+		return NULL;
+
+	if (at < end && (*at == 'e' || *at == 'E'))
+	{
+		const char *after = at + 1;
+		bool negativeExponent = false;
+		if (after < end && (*after == '-' || *after == '+'))
+			negativeExponent = *after++ == '-';
+		int written = 0;
+		for (; after < end && isDigit(*after); after++)
+			written = std::min(written * 10 + (*after - '0'), 1000);
+		if (after > at + 1 && isDigit(after[-1]))
+		{
+			exponent += negativeExponent ? -written : written;
+			at = after;
+		}
+	}
+
+	double result = (double)mantissa;
+	if (exponent < 0)
+		result = exponent >= -22 ? result / powers[-exponent] : result * pow(10.0, exponent);
+	else if (exponent > 0)
+		result = exponent <= 22 ? result * powers[exponent] : result * pow(10.0, exponent);
+	value = (float)(negative ? -result : result);
+	return at;
+}
+
+// a face corner is v, v/vt, v//vn or v/vt/vn and only v matters. NULL if no index
+const char *parseCorner(const char *at, const char *end, long long &index)
+{
+	bool negative = false;
+	if (at < end && (*at == '-' || *at == '+'))
+		negative = *at++ == '-';
+	const char *digits = at;
+	index = 0;
+	for (; at < end && isDigit(*at); at++)
+		index = std::min(index * 10 + (*at - '0'), 0xffffffffll);
+	if (at == digits)
+		return NULL;
+	if (negative)
+		index = -index;
+	while (at < end && !isBlank(*at))
+		at++;
+	return at;
+}
+
+
+// OBJ
+
+// a line aligned piece of the file. counting fills in how many vertices and triangles it
+// has, those become where its own start once every chunk is counted
+struct ObjChunk
+{
+	const char *begin, *end;
+	unsigned int vertices, triangles;
+	const char *bad;			// first line that could not be read
+};
+
+// counts when mesh is NULL, otherwise fills the chunk's share of the mesh. both passes
+// skip and reject the same lines so the counts always match what gets filled
+void parseChunk(ObjChunk &chunk, ImportedMesh *mesh)
+{
+	unsigned int	vertex = mesh ? chunk.vertices : 0,
+					triangle = mesh ? chunk.triangles : 0;
+	const unsigned int vertexCount = mesh ? (unsigned int)mesh->positions.size() : 0;
+
+	for (const char *line = chunk.begin; line < chunk.end; )
+	{
+		const char	*end = findLineEnd(line, chunk.end),
+					*at = skipBlanks(line, end);
+		bool bad = false;
+
+		if (end - at > 1 && at[0] == 'v' && isBlank(at[1]))
+		{
+			if (mesh)
+			{
+				vec3 &position = mesh->positions[vertex];
+				at += 1;
+				for (int axis = 0; axis < 3 && !bad; axis++)
+				{
+					at = parseFloat(skipBlanks(at, end), end, position[axis]);
+					bad = !at;
+				}
+			}
+			vertex++;
+		}
+		else if (end - at > 1 && at[0] == 'f' && isBlank(at[1]))
+		{
+			// a fan around the first corner. negative indices count back from the vertex
+			// before the line, which only the filling pass knows
+			unsigned int corners = 0, first = 0, previous = 0;
+			at = skipBlanks(at + 1, end);
+			while (at < end && *at != '#')
+			{
+				long long index;
+				at = parseCorner(at, end, index);
+				if (!at)
+				{
+					bad = true;
+					break;
+				}
+				if (mesh)
+				{
+					long long resolved = index > 0 ? index - 1 : (long long)vertex + index;
+					if (index == 0 || resolved < 0 || resolved >= vertexCount)
+					{
+						bad = true;
+						resolved = 0;
+					}
+					unsigned int current = (unsigned int)resolved;
+					if (corners == 0)
+						first = current;
+					else if (corners >= 2)
+					{
+						unsigned int *out = &mesh->triangles[3 * (size_t)triangle];
+						out[0] = first;
+						out[1] = previous;
+						out[2] = current;
+					}
+					previous = current;
+				}
+				if (corners >= 2)
+					triangle++;
+				corners++;
+				at = skipBlanks(at, end);
+			}
+			bad = bad || corners < 3;
+		}
+
+		if (bad && !chunk.bad)
+			chunk.bad = line;
+		line = end + 1;
+	}
+
+	if (!mesh)
+	{
+		chunk.vertices = vertex;
+		chunk.triangles = triangle;
+	}
+}
+
+bool importOBJ(const std::string &filename, ImportedMesh &mesh)
+{
+	FileMap file;
+	if (!mapFile(file, filename))
+		return false;
+	const char	*data = (const char*)file.data,
+				*end = data + file.size;
+
+	// chunks start after the first line break at or past each multiple of the chunk size,
+	// a line longer than a chunk leaves the chunks it covers empty
+	const int chunkCount = (int)((file.size + importChunk - 1) / importChunk);
+	std::vector<ObjChunk> chunks(chunkCount);
+	#pragma omp parallel for
+	for (int i = 0; i < chunkCount; i++)
+	{
+		const char *begin = data;
+		if (i > 0)
+		{
+			begin = findLineEnd(data + (size_t)i * importChunk - 1, end);
+			begin = begin < end ? begin + 1 : end;
+		}
+		chunks[i].begin = begin;
+		chunks[i].bad = NULL;
+	}
+	for (int i = 0; i < chunkCount; i++)
+		chunks[i].end = i + 1 < chunkCount ? chunks[i + 1].begin : end;
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < chunkCount; i++)
+		parseChunk(chunks[i], NULL);
+
+	unsigned long long vertexCount = 0, triangleCount = 0;
+	for (int i = 0; i < chunkCount; i++)
+	{
+		unsigned int vertices = chunks[i].vertices, triangles = chunks[i].triangles;
+		chunks[i].vertices = (unsigned int)vertexCount;
+		chunks[i].triangles = (unsigned int)triangleCount;
+		vertexCount += vertices;
+		triangleCount += triangles;
+	}
+	if (vertexCount > 0xffffffffull || 3 * triangleCount > 0xffffffffull)
+	{
+		std::cout << "FILE " << filename << " HAS TOO MANY VERTICES OR FACES" << std::endl;
+		unmapFile(file);
+		return false;
+	}
+
+	mesh.positions.resize((size_t)vertexCount);
+	mesh.triangles.resize(3 * (size_t)triangleCount);
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < chunkCount; i++)
+		parseChunk(chunks[i], &mesh);
+
+	const char *bad = NULL;
+	for (int i = 0; i < chunkCount && !bad; i++)
+		bad = chunks[i].bad;
+	if (bad)
+	{
+		size_t line = 1 + std::count(data, bad, '\n');
+		std::cout << "FILE " << filename << " LINE " << line << " COULD NOT BE READ" << std::endl;
+	}
+	unmapFile(file);
+	if (bad)
+		return false;
+
+	// faces that repeat a vertex have no area, the solver would only trip over them
+	std::vector<unsigned int> &triangles = mesh.triangles;
+	size_t kept = 0;
+	for (size_t i = 0; i < triangles.size(); i += 3)
+	{
+		unsigned int a = triangles[i], b = triangles[i + 1], c = triangles[i + 2];
+		if (a == b || b == c || a == c)
+			continue;
+		triangles[kept++] = a;
+		triangles[kept++] = b;
+		triangles[kept++] = c;
+	}
+	triangles.resize(kept);
+	return true;
+}
+
+
+// TetGen
+
+// walks a mapped file a line at a time, the way TetGen files are laid out: a header line of
+// counts, then a line per item. blank lines and # comments are passed over
+struct TextCursor
+{
+	const char *at, *lineEnd;		// what is left of the current line
+	const char *next, *end;
+	unsigned int line;
+};
+
+bool nextLine(TextCursor &cursor)
+{
+	while (cursor.next < cursor.end)
+	{
+		const char *start = cursor.next;
+		cursor.lineEnd = findLineEnd(start, cursor.end);
+		cursor.next = cursor.lineEnd < cursor.end ? cursor.lineEnd + 1 : cursor.end;
+		cursor.line++;
+
+		const char *comment = (const char*)memchr(start, '#', cursor.lineEnd - start);
+		if (comment)
+			cursor.lineEnd = comment;
+		start = skipBlanks(start, cursor.lineEnd);
+		if (start < cursor.lineEnd)
+		{
+			cursor.at = start;
+			return true;
+		}
+	}
+	return false;
+}
+
+// the next number on the line, the cursor moves past it
+bool readNumber(TextCursor &cursor, float &value)
+{
+	const char *after = parseFloat(skipBlanks(cursor.at, cursor.lineEnd), cursor.lineEnd, value);
+	if (!after)
+		return false;
+	cursor.at = after;
+	return true;
+}
+
+bool readIndex(TextCursor &cursor, long long &index)
+{
+	const char *at = skipBlanks(cursor.at, cursor.lineEnd);
+	if (at >= cursor.lineEnd || (!isDigit(*at) && *at != '-'))
+		return false;
+	const char *after = parseCorner(at, cursor.lineEnd, index);
+	if (!after)
+		return false;
+	cursor.at = after;
+	return true;
+}
+
+bool openCursor(FileMap &file, TextCursor &cursor, const std::string &filename)
+{
+	if (!mapFile(file, filename))
+		return false;
+	cursor.next = (const char*)file.data;
+	cursor.end = cursor.next + file.size;
+	cursor.at = cursor.lineEnd = cursor.next;
+	cursor.line = 0;
+	return true;
+}
+
+bool tetGenError(FileMap &file, const std::string &filename, const TextCursor &cursor)
+{
+	std::cout << "FILE " << filename << " LINE " << cursor.line << " COULD NOT BE READ" << std::endl;
+	unmapFile(file);
+	return false;
+}
+
+// name.node holds the vertices, name.ele the tetrahedra. both number from 0 or both from 1,
+// whatever the first vertex is numbered. extra attributes and boundary markers are skipped,
+// and of a 10 node tetrahedron only its corners are kept
+bool importTetGen(const std::string &filename, ImportedTets &mesh)
+{
+	std::string base = filename;
+	size_t dot = base.find_last_of('.');
+	if (dot != std::string::npos && (base.substr(dot) == ".node" || base.substr(dot) == ".ele"))
+		base.erase(dot);
+
+	FileMap file;
+	TextCursor cursor;
+	std::string nodeFile = base + ".node";
+	if (!openCursor(file, cursor, nodeFile))
+		return false;
+	long long nodeCount, dimension;
+	if (!nextLine(cursor) || !readIndex(cursor, nodeCount) || !readIndex(cursor, dimension) || dimension != 3 || nodeCount <= 0)
+		return tetGenError(file, nodeFile, cursor);
+
+	mesh.positions.resize((size_t)nodeCount);
+	long long first = -1;
+	for (long long i = 0; i < nodeCount; i++)
+	{
+		long long index;
+		if (!nextLine(cursor) || !readIndex(cursor, index))
+			return tetGenError(file, nodeFile, cursor);
+		if (first < 0)
+			first = index;
+		index -= first;
+		vec3 &position = mesh.positions[(size_t)(index >= 0 && index < nodeCount ? index : 0)];
+		if (index < 0 || index >= nodeCount ||
+			!readNumber(cursor, position.x) || !readNumber(cursor, position.y) || !readNumber(cursor, position.z))
+			return tetGenError(file, nodeFile, cursor);
+	}
+	unmapFile(file);
+
+	std::string elementFile = base + ".ele";
+	if (!openCursor(file, cursor, elementFile))
+		return false;
+	long long tetCount, corners;
+	if (!nextLine(cursor) || !readIndex(cursor, tetCount) || !readIndex(cursor, corners) || (corners != 4 && corners != 10) || tetCount < 0)
+		return tetGenError(file, elementFile, cursor);
+
+	mesh.tetrahedra.resize(4 * (size_t)tetCount);
+	for (long long i = 0; i < tetCount; i++)
+	{
+		long long index;
+		if (!nextLine(cursor) || !readIndex(cursor, index))
+			return tetGenError(file, elementFile, cursor);
+		for (int k = 0; k < 4; k++)
+		{
+			long long corner;
+			if (!readIndex(cursor, corner) || corner - first < 0 || corner - first >= nodeCount)
+				return tetGenError(file, elementFile, cursor);
+			mesh.tetrahedra[4 * (size_t)i + k] = (unsigned int)(corner - first);
+		}
+	}
+	unmapFile(file);
+	return true;
+}
+
+// a quarter of every tetrahedron's volume to each of its corners, then scaled to the mean.
+// masses no tetrahedron uses get the mean, they would be weightless otherwise
+void lumpTetMasses(std::vector<Mass> &masses, const std::vector<unsigned int> &tetrahedra, float meanMass)
+{
+	std::vector<float> lumped(masses.size(), 0.f);
+	for (size_t i = 0; i < tetrahedra.size(); i += 4)
+	{
+		const vec3 &a = masses[tetrahedra[i]].position;
+		float volume = std::abs(dot(masses[tetrahedra[i + 1]].position - a,
+									cross(masses[tetrahedra[i + 2]].position - a, masses[tetrahedra[i + 3]].position - a))) / 6.f;
+		for (int k = 0; k < 4; k++)
+			lumped[tetrahedra[i + k]] += .25f * volume;
+	}
+
+	double total = 0.0;
+	unsigned int used = 0;
+	for (size_t i = 0; i < lumped.size(); i++)
+	{
+		total += lumped[i];
+		used += lumped[i] > 0.f;
+	}
+	float scale = total > 0.0 ? (float)(used * meanMass / total) : 0.f;
+	for (size_t i = 0; i < masses.size(); i++)
+		masses[i].mass = lumped[i] > 0.f ? lumped[i] * scale : meanMass;
+}
+
+
+// springs
+
+#define emptyEdge		(~0ull)
+
+// open addressing on the edge's two masses. a slot remembers the lowest and highest
+// element edge that reached it, the lowest owns the edge so the springs come out in the
+// elements' order however the threads arrived
+struct EdgeTable
+{
+	EdgeTable(size_t size) :	keys(size),
+								first(size),
+								last(size) { }
+	std::vector<std::atomic<unsigned long long> > keys;
+	std::vector<std::atomic<unsigned int> > first, last;
+	unsigned long long mask;
+	int shift;
+};
+
+inline unsigned long long edgeKey(unsigned int a, unsigned int b)
+{
+	return ((unsigned long long)std::min(a, b) << 32) | std::max(a, b);
+}
+
+unsigned int insertEdge(EdgeTable &table, unsigned long long key)
+{
+	unsigned long long slot = (key * 0x9e3779b97f4a7c15ull) >> table.shift;
+	for (;; slot = (slot + 1) & table.mask)
+	{
+		unsigned long long current = table.keys[slot].load(std::memory_order_relaxed);
+		if (current == emptyEdge &&
+			table.keys[slot].compare_exchange_strong(current, key, std::memory_order_relaxed))
+			return (unsigned int)slot;
+		if (current == key)
+			return (unsigned int)slot;
+	}
+}
+
+void lowerTo(std::atomic<unsigned int> &value, unsigned int edge)
+{
+	unsigned int current = value.load(std::memory_order_relaxed);
+	while (edge < current && !value.compare_exchange_weak(current, edge, std::memory_order_relaxed)) { }
+}
+
+void raiseTo(std::atomic<unsigned int> &value, unsigned int edge)
+{
+	unsigned int current = value.load(std::memory_order_relaxed);
+	while (edge > current && !value.compare_exchange_weak(current, edge, std::memory_order_relaxed)) { }
+}
+
+// at least twice as many slots as element edges, so the table stays sparse
+size_t edgeTableSize(size_t edgeCount)
+{
+	size_t size = 2;
+	while (size < 2 * edgeCount)
+		size *= 2;
+	return size;
+}
+
+// every element edge into the table, slots gets where each one landed
+void fillEdgeTable(EdgeTable &table, const std::vector<unsigned long long> &edges, std::vector<unsigned int> &slots)
+{
+	int bits = 1;
+	while (((size_t)1 << bits) < table.keys.size())
+		bits++;
+	table.mask = ((unsigned long long)1 << bits) - 1;
+	table.shift = 64 - bits;
+
+	const int tableSize = (int)table.keys.size();
+	#pragma omp parallel for
+	for (int i = 0; i < tableSize; i++)
+	{
+		table.keys[i].store(emptyEdge, std::memory_order_relaxed);
+		table.first[i].store(~0u, std::memory_order_relaxed);
+		table.last[i].store(0, std::memory_order_relaxed);
+	}
+
+	const int edgeCount = (int)edges.size();
+	slots.resize(edgeCount);
+	#pragma omp parallel for
+	for (int i = 0; i < edgeCount; i++)
+	{
+		unsigned int slot = insertEdge(table, edges[i]);
+		lowerTo(table.first[slot], i);
+		raiseTo(table.last[slot], i);
+		slots[i] = slot;
+	}
+}
+
+// a spring for each item makeSpring fills one in for, counted per block of items then
+// written from each block's offset so they keep the items' order
+template <typename MakeSpring>
+void appendSprings(int itemCount, std::vector<Spring> &springs, MakeSpring makeSpring)
+{
+	const int blockCount = (itemCount + importSideBlock - 1) / importSideBlock;
+	std::vector<size_t> offsets(blockCount + 1, 0);
+	#pragma omp parallel for
+	for (int block = 0; block < blockCount; block++)
+	{
+		Spring s;
+		int blockEnd = std::min(itemCount, (block + 1) * importSideBlock);
+		for (int i = block * importSideBlock; i < blockEnd; i++)
+			offsets[block + 1] += makeSpring(i, s);
+	}
+	offsets[0] = springs.size();
+	for (int block = 0; block < blockCount; block++)
+		offsets[block + 1] += offsets[block];
+
+	springs.resize(offsets[blockCount]);
+	#pragma omp parallel for
+	for (int block = 0; block < blockCount; block++)
+	{
+		Spring s;
+		size_t next = offsets[block];
+		int blockEnd = std::min(itemCount, (block + 1) * importSideBlock);
+		for (int i = block * importSideBlock; i < blockEnd; i++)
+			if (makeSpring(i, s))
+				springs[next++] = s;
+	}
+}
+
+// a spring per table edge, at the element edge that owns it
+void appendEdgeSprings(const EdgeTable &table, const std::vector<unsigned int> &slots,
+					   const std::vector<Mass> &masses, float constant, std::vector<Spring> &springs)
+{
+	appendSprings((int)slots.size(), springs, [&](int i, Spring &s)
+	{
+		unsigned int slot = slots[i];
+		if (table.first[slot] != (unsigned int)i)
+			return false;
+		unsigned long long key = table.keys[slot];
+		s.m1 = (unsigned int)(key >> 32);
+		s.m2 = (unsigned int)key;
+		if (s.m1 == s.m2)
+			return false;
+		s.restLength = length(masses[s.m1].position - masses[s.m2].position);
+		s.constant = constant;
+		return true;
+	});
+}
+
+inline unsigned int oppositeCorner(const std::vector<unsigned int> &triangles, unsigned int side)
+{
+	return triangles[side - side % 3 + (side + 2) % 3];
+}
+
+void buildEdgeSprings(const std::vector<Mass> &masses, const std::vector<unsigned int> &triangles,
+					  float constant, float bendConstant, std::vector<Spring> &springs)
+{
+	const int sideCount = (int)triangles.size();
+	std::vector<unsigned long long> sides(sideCount);
+	#pragma omp parallel for
+	for (int i = 0; i < sideCount; i++)
+		sides[i] = edgeKey(triangles[i], triangles[i - i % 3 + (i + 1) % 3]);
+
+	EdgeTable table(edgeTableSize(sides.size()));
+	std::vector<unsigned int> slots;
+	fillEdgeTable(table, sides, slots);
+	appendEdgeSprings(table, slots, masses, constant, springs);
+
+	// the last side to reach an edge is the other triangle's, if another has it
+	appendSprings(sideCount, springs, [&](int i, Spring &s)
+	{
+		unsigned int	slot = slots[i],
+						other = table.last[slot];
+		if (table.first[slot] != (unsigned int)i || other == (unsigned int)i)
+			return false;
+		unsigned int	m1 = oppositeCorner(triangles, i),
+						m2 = oppositeCorner(triangles, other);
+		if (m1 == m2)
+			return false;
+		s.m1 = std::min(m1, m2);
+		s.m2 = std::max(m1, m2);
+		s.restLength = length(masses[s.m1].position - masses[s.m2].position);
+		s.constant = bendConstant;
+		return true;
+	});
+}
+
+void buildTetSprings(const std::vector<Mass> &masses, const std::vector<unsigned int> &tetrahedra,
+					 float constant, std::vector<Spring> &springs)
+{
+	static const int corners[6][2] = { { 0, 1 }, { 0, 2 }, { 0, 3 }, { 1, 2 }, { 1, 3 }, { 2, 3 } };
+	const int tetCount = (int)(tetrahedra.size() / 4);
+	std::vector<unsigned long long> edges(6 * (size_t)tetCount);
+	#pragma omp parallel for
+	for (int i = 0; i < tetCount; i++)
+	{
+		const unsigned int *tet = &tetrahedra[4 * (size_t)i];
+		for (int k = 0; k < 6; k++)
+			edges[6 * (size_t)i + k] = edgeKey(tet[corners[k][0]], tet[corners[k][1]]);
+	}
+
+	EdgeTable table(edgeTableSize(edges.size()));
+	std::vector<unsigned int> slots;
+	fillEdgeTable(table, edges, slots);
+	const size_t first = springs.size();
+	appendEdgeSprings(table, slots, masses, constant, springs);
+
+	// stiffness goes with length, a small tetrahedron's edges are as soft as it is small
+	double total = 0.0;
+	for (size_t i = first; i < springs.size(); i++)
+		total += springs[i].restLength;
+	if (total <= 0.0)
+		return;
+	const float scale = (float)((springs.size() - first) / total);
+	const int springCount = (int)springs.size();
+	#pragma omp parallel for
+	for (int i = (int)first; i < springCount; i++)
+		springs[i].constant = constant * springs[i].restLength * scale;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Header.h"
+#include <string>
+
+#define importChunk			(1 << 20)	// bytes of file a thread parses at a time
+#define importSideBlock		(1 << 16)	// element edges a thread turns into springs at a time
+
+// a mesh as the file has it, in its own units
+struct ImportedMesh
+{
+	std::vector<glm::vec3> positions;
+	std::vector<unsigned int> triangles;		// 3 position indices per triangle
+};
+
+// a tetrahedral mesh, in the file's units
+struct ImportedTets
+{
+	std::vector<glm::vec3> positions;
+	std::vector<unsigned int> tetrahedra;		// 4 position indices per tetrahedron
+};
+
+// a number in decimal or exponent notation at at, the same in any locale. where it ends,
+// NULL if there is none
+const char *parseFloat(const char *at, const char *end, float &value);
+
+// vertices and faces of a Wavefront OBJ, everything else in the file is skipped. polygons
+// become fans of triangles, texture and normal indices are dropped. the file is mapped and
+// parsed by every thread at once, chunk by chunk, so the result does not depend on how
+// many threads there were
+bool importOBJ(const std::string &filename, ImportedMesh &mesh);
+
+// a structural spring along every edge of the triangles, once however many triangles share
+// it, and a bend spring across every edge two triangles share, between the corners
+// opposite it. rest lengths are the distances the masses start at
+void buildEdgeSprings(const std::vector<Mass> &masses, const std::vector<unsigned int> &triangles,
+					  float constant, float bendConstant, std::vector<Spring> &springs);
+
+// TetGen's name.node and name.ele, filename with either extension or none. both are read
+// in one pass through the mapped file, the counts up front size everything
+bool importTetGen(const std::string &filename, ImportedTets &mesh);
+
+// every tetrahedron's volume split between its corners, scaled so the masses average
+// meanMass. the solver's damping is tuned for masses near 1, a mesh as heavy as it is
+// fine would need a smaller time step
+void lumpTetMasses(std::vector<Mass> &masses, const std::vector<unsigned int> &tetrahedra, float meanMass);
+
+// a spring along every edge of the tetrahedra, once however many share it. constant is
+// the stiffness of an edge of mean length, longer edges are stiffer and shorter ones softer
+void buildTetSprings(const std::vector<Mass> &masses, const std::vector<unsigned int> &tetrahedra,
+					 float constant, std::vector<Spring> &springs);
@@ -1,83 +1,277 @@
 #include "Header.h"
 #include "ShaderBuilder.h"
+#include "Collision.h"
+#include "Colliders.h"
+#include "Topology.h"
+#include "Broadphase.h"
+#include "Offscreen.h"
+#include "ShaderWatcher.h"
+#include "Surface.h"
+#include "Trajectory.h"
+#include "Checkpoint.h"
+#include "SharedState.h"
+#include "StreamServer.h"
+#include "Export.h"
+#include "Import.h"
+#include "Scene.h"
+#include "Batch.h"
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/transform.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
 #include <iostream>
 #include <string>
 
 using namespace glm;
 
-#define defaultPlaneSize	2.f
-#define defaultPlaneHeight	2.f
-#define clothPlaneSize		0.1f
-#define clothPlaneHeight	0.5f
+
+#define pileCubeLayers		2
+
+// what the number key scenes are built with when there is nobody to ask, headless
+#define defaultChainMasses	5
+#define defaultCubeLayers	3
+#define defaultPileCubes	27
+#define defaultClothLayers	30
 
 #define antiAliasing		4
 
+#define physicsFrame		(timeStep / stepsPerSecond)	// simulated seconds per stepSimulation
+#define maxFrameLag			.25							// wall seconds a slow frame may ask physics to catch up
+#define defaultCheckpoint	"checkpoint.phck"			// F5 and F9 without --checkpoint
+
+#define massRadius			.03f	// drawn size of the mass spheres
+#define maxColorSpeed		5.f		// speed drawn fully red
+#define maxColorStrain		(defaultTearThreshold - 1.f)	// strain drawn fully red, where springs tear
+
 const GLfloat clearColor[] = { 0.f, 0.f, 0.f };
 
 int		state = singleSpringState;
 bool	stateChange = false, 
-		simulation = true;
+		simulation = true,
+		clothSurface = true,
+		decoupledRendering = false,
+		playback = false,
+		checkpointSave = false,		// requested from the keyboard, done between frames
+		checkpointRestore = false;
+int		massColoring = speedColoring;
+float	playbackSpeed = 1.f;
+double	playbackFrame = 0.0;					// recorded frame being shown, fractional between steps
 float	planeHeight = defaultPlaneHeight,
 		planeSize = defaultPlaneSize;
+int		sceneSize = 0;							// --layers, asked for when 0 and there is a window
+bool	askSceneSize = true;					// false headless, stdin may be a pipe or nothing
 
 GLuint	springVertexArray, 
 		massVertexArray, 
+		massVertexBuffer,
+		springElementBuffer,
+		clothVertexArray,
+		clothNormalBuffer,
+		clothElementBuffer,
 	
 		planeProgram,
 		springProgram, 
-		massProgram;
+		massProgram,
+		clothProgram;
+GLint	planeHeightLocation,
+		planeSizeLocation,
+		massRadiusLocation;
 
 std::vector<Mass> massVec;
 std::vector<Spring> springVec;
+TriangleMesh clothMesh;
+SurfaceNormals clothSurfaceNormals;
+BVH clothBVH;
+ColliderSet colliderSet;
+SpringTopology springTopology;
+std::vector<Body> bodyVec;
+SortAndSweep broadphase;
+std::vector<MassVertex> massVertices;
+std::vector<vec3> previousPositions;	// the state before the last step, for interpolation
+double simulationLag = 0.0;				// wall time not yet simulated
+unsigned int simulationFrame = 0;		// physics frames since the scene was built
+float renderAlpha = 1.f;				// where the drawn state sits between the last two
+ShaderWatcher shaderWatcher;
+TrajectoryRecorder recorder;
+TrajectoryPlayer player;
+SharedState sharedState;
+StreamServer streamServer;
+FrameExporter exporter;
+std::vector<std::string> changedShaders;
+std::string meshFile;					// the mesh scene's OBJ
+std::string tetFile;					// the tetrahedra scene's TetGen files
+std::string sceneFile;					// the scene file scene's
+SceneDescription sceneDescription;		// as last read from it
+
+extern float aspectRatio;
+
+SpringKernel springKernel = springSystem;
+SolverSettings solver;
 
 // buffer generation
-void generateMassBuffer()
+// the masses live in one vertex buffer, springs are drawn from it through an index
+// buffer that tearing patches in place
+void generateBuffers()
 {
+	glGenBuffers(1, &massVertexBuffer);
+	glGenBuffers(1, &springElementBuffer);
 
-	GLuint massVertexBuffer = 0;
-
+	// one sphere per mass, each instance reads its position and attribute word
 	glGenVertexArrays(1, &massVertexArray);
 	glBindVertexArray(massVertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, massVertexBuffer);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MassVertex), NULL);
+	glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(MassVertex), (void*)offsetof(MassVertex, attributes));
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribDivisor(0, 1);
+	glVertexAttribDivisor(1, 1);
 
-	std::vector<vec3> masses;
-
-	for (unsigned int i = 0; i < massVec.size(); i++)
-		masses.push_back(massVec[i].position);
+	glGenVertexArrays(1, &springVertexArray);
+	glBindVertexArray(springVertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, massVertexBuffer);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MassVertex), NULL);
+	glEnableVertexAttribArray(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, springElementBuffer);
 
-	glGenBuffers(1, &massVertexBuffer);
+	// the cloth surface shares the positions, its normals come from their own buffer
+	glGenBuffers(1, &clothNormalBuffer);
+	glGenBuffers(1, &clothElementBuffer);
+	glGenVertexArrays(1, &clothVertexArray);
+	glBindVertexArray(clothVertexArray);
 	glBindBuffer(GL_ARRAY_BUFFER, massVertexBuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(masses[0]) * masses.size(), &masses[0], GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MassVertex), NULL);
 	glEnableVertexAttribArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, clothNormalBuffer);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+	glEnableVertexAttribArray(1);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, clothElementBuffer);
+
+	glBindVertexArray(0);
+
+	generateCameraBuffer();
+}
+
+// the largest stretch or compression of the springs on a mass, as a fraction of rest length
+float massStrain(unsigned int mass)
+{
+	float strain = 0.f;
+	for (unsigned int j = 0; j < springTopology.rowCount[mass]; j++)
+	{
+		const Spring &s = springVec[springTopology.incident[springTopology.rowStart[mass] + j]];
+		float length = distance(massVec[s.m1].position, massVec[s.m2].position);
+		strain = max(strain, abs(length - s.restLength) / s.restLength);
+	}
+	return strain;
+}
+
+void generateMassBuffer()
+{
+	const int massCount = (int)massVec.size();
+	massVertices.resize(massCount);
+	bool strain = massColoring == strainColoring && !springTopology.rowCount.empty();
+
+	bool interpolate = decoupledRendering && previousPositions.size() == massVec.size();
+
+	#pragma omp parallel for
+	for (int i = 0; i < massCount; i++)
+	{
+		const Mass &m = massVec[i];
+		float value = strain ?	massStrain(i) / maxColorStrain :
+								length(m.velocity) / maxColorSpeed;
+		massVertices[i].position = interpolate ? mix(previousPositions[i], m.position, renderAlpha) : m.position;
+		massVertices[i].attributes = packMassAttributes(m.fixed, value);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, massVertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(MassVertex) * massVertices.size(), massVertices.data(), GL_STREAM_DRAW);
+}
+
+// the triangles never change after the scene is built, only the normals follow the masses
+void generateClothBuffers()
+{
+	buildSurface(clothSurfaceNormals, clothMesh, (unsigned int)massVec.size());
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, clothElementBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * clothMesh.triangles.size(), clothMesh.triangles.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void generateNormalBuffer()
+{
+	if (!clothSurface || clothMesh.triangles.empty())
+		return;
+
+	computeNormals(clothSurfaceNormals, clothMesh, massVec);
+	glBindBuffer(GL_ARRAY_BUFFER, clothNormalBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vec3) * clothSurfaceNormals.normals.size(), clothSurfaceNormals.normals.data(), GL_STREAM_DRAW);
 }
 
 void generateSpringBuffer()
 {
-	GLuint springVertexBuffer = 0;
+	std::vector<GLuint> springs;
+	for (unsigned int i = 0; i < springVec.size(); i++)
+	{
+		springs.push_back(springVec[i].m1);
+		springs.push_back(springVec[i].m2);
+	}
 
-	glGenVertexArrays(1, &springVertexArray);
 	glBindVertexArray(springVertexArray);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * springs.size(), springs.data(), GL_DYNAMIC_DRAW);
+	glBindVertexArray(0);
 
-	std::vector<vec3> springs;
+	springTopology.dirty.clear();
+}
 
-	for (unsigned int i = 0; i < springVec.size(); i++)
+// rewrite only the lines whose springs were swapped around by tearing
+void updateSpringBuffer()
+{
+	unsigned int	lower = (unsigned int)springVec.size(),
+					upper = 0;
+	for (unsigned int i = 0; i < springTopology.dirty.size(); i++)
 	{
-		springs.push_back(massVec[springVec[i].m1].position);
-		springs.push_back(massVec[springVec[i].m2].position);
+		unsigned int s = springTopology.dirty[i];
+		if (s < springVec.size())
+		{
+			lower = min(lower, s);
+			upper = max(upper, s + 1);
+		}
 	}
 
-	glGenBuffers(1, &springVertexBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, springVertexBuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(springs[0]) * springs.size(), &springs[0], GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(0);
+	if (lower < upper)
+	{
+		glBindVertexArray(springVertexArray);
+		GLuint *lines = (GLuint*)glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 2 * sizeof(GLuint) * lower, 2 * sizeof(GLuint) * (upper - lower), GL_MAP_WRITE_BIT);
+		for (unsigned int i = 0; i < springTopology.dirty.size(); i++)
+		{
+			unsigned int s = springTopology.dirty[i];
+			if (s < upper && s >= lower)
+			{
+				lines[2 * (s - lower)] = springVec[s].m1;
+				lines[2 * (s - lower) + 1] = springVec[s].m2;
+			}
+		}
+		glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+		glBindVertexArray(0);
+	}
+
+	springTopology.dirty.clear();
 }
 
 
 // system generation
-int userInput(std::string str)
+// the size of a scene, from the command line, asked for or headless its default
+int userInput(std::string str, int headlessValue)
 {
+	if (sceneSize > 0)
+		return sceneSize;
+	if (!askSceneSize)
+	{
+		std::cout << str << headlessValue << std::endl;
+		return headlessValue;
+	}
+
 	// get user input, restricted to integers
 	do
 	{
@@ -122,7 +316,7 @@ void generateSingleSpringSystem()
 
 void generateMultiSpringSystem()
 {
-	int numOfMasses = userInput("Enter number of masses on spring chain: ");
+	int numOfMasses = userInput("Enter number of masses on spring chain: ", defaultChainMasses);
 
 	// always need the single fixed point at the top
 	Mass fixed;
@@ -145,16 +339,17 @@ void generateMultiSpringSystem()
 	}
 }
 
-void generateCubeSpringSystem()
+// one cube of numOfLayers^3 masses around center, added to the scene as its own body
+void generateCube(int numOfLayers, vec3 center)
 {
-	int		numOfLayers = userInput("Enter number of cube layers: "),
-			top = numOfLayers / 2,
+	int		top = numOfLayers / 2,
 			bottom = -top,
 			springLayers = 1;
-	float	massDistance = .2f,
+	float	massDistance = cubeMassDistance,
 			// equation of a sphere. all masses contained need to be connected to center mass
 			// + .01f for floating point error
 			springDistance = .01f + sqrt(3.f * pow(springLayers * massDistance, 2.f));
+	unsigned int firstMass = (unsigned int)massVec.size();
 
 	// generate the network of masses
 	float x = bottom * massDistance;
@@ -167,7 +362,7 @@ void generateCubeSpringSystem()
 			for (float zLayer = 0; zLayer < numOfLayers; zLayer++)
 			{
 				Mass m;
-				m.position = glm::vec3(x, y, z);
+				m.position = center + glm::vec3(x, y, z);
 				massVec.push_back(m);
 				z += massDistance;
 			}
@@ -179,7 +374,7 @@ void generateCubeSpringSystem()
 
 	// generate the spring network
 
-	for (unsigned int i = 0; i < massVec.size(); i++)
+	for (unsigned int i = firstMass; i < massVec.size(); i++)
 	{
 		for (unsigned int j = i + 1; j < massVec.size(); j++)
 		{
@@ -195,139 +390,243 @@ void generateCubeSpringSystem()
 			}
 		}
 	}
+
+	Body body;
+	body.firstMass = firstMass;
+	body.massCount = (unsigned int)massVec.size() - firstMass;
+	bodyVec.push_back(body);
 }
 
-void generateClothHangSpringSystem()
+void generateCubeSpringSystem()
 {
-	int numOfLayers = userInput("Enter diameter of cloth: "),
-		springLayers = 2,
-		top = numOfLayers / 2,
-		bottom = -top;
-	float	massDistance = .005f,
-		massMass = .1f,
-		// equation of a sphere. all masses contained need to be connected to center mass
-		// + .01f for floating point error
-		springDistance = .01f + sqrt(3.f * pow(springLayers * massDistance, 2.f)),
-		springConstant = 2000.f;
+	generateCube(userInput("Enter number of cube layers: ", defaultCubeLayers), vec3(0.f, 0.f, 0.f));
+}
 
+// small cubes stacked in columns over the plane, jittered so the stacks topple
+void generateCubePileSystem()
+{
+	int		numOfCubes = userInput("Enter number of cubes: ", defaultPileCubes),
+			side = (int)ceil(pow((float)numOfCubes, 1.f / 3.f));
+	float	spacing = (pileCubeLayers + 1) * cubeMassDistance,
+			jitter = .25f * cubeMassDistance;
 
+	planeSize = max(defaultPlaneSize, .5f * side * spacing + spacing);
 
-	// generate the network of masses
-	float x = bottom * massDistance;
-	for (float xLayer = 0; xLayer < numOfLayers; xLayer++)
+	for (int i = 0; i < numOfCubes; i++)
 	{
-		float	y = bottom * massDistance,
-			z = bottom * massDistance;
-		for (int yLayer = 0; yLayer < numOfLayers; yLayer++)
-		{
-			Mass m;
-			m.position = glm::vec3(x, y, z);
-			m.mass = massMass;
-			if (xLayer >= 5 && xLayer < 10 && yLayer >= 5 && yLayer < 10)
-				m.fixed = true;
-			massVec.push_back(m);
+		int		xColumn = i % side,
+				zColumn = (i / side) % side,
+				yLayer = i / (side * side);
+		vec3	offset(	jitter * (2.f * rand() / RAND_MAX - 1.f),
+						0.f,
+						jitter * (2.f * rand() / RAND_MAX - 1.f));
+		generateCube(pileCubeLayers, offset + vec3((xColumn - .5f * (side - 1)) * spacing,
+											planeHeight + (yLayer + 1) * spacing,
+											(zColumn - .5f * (side - 1)) * spacing));
+	}
+}
 
-			y += massDistance;
-			z += massDistance;
-		}
-		x += massDistance;
+SceneBodies currentBodies()
+{
+	SceneBodies scene = { massVec, springVec, clothMesh.triangles, bodyVec };
+	return scene;
+}
+
+// the --obj mesh as cloth
+bool generateMeshSystem()
+{
+	if (meshFile.empty())
+	{
+		std::cout << "No mesh to import, start with --obj <file>" << std::endl;
+		return false;
 	}
+	BodyDescription body = defaultBody(meshBody);
+	body.file = meshFile;
+	SceneBodies scene = currentBodies();
+	return addMeshBody(scene, body);
+}
 
+// the --tet tetrahedra as a soft body
+bool generateTetSystem()
+{
+	if (tetFile.empty())
+	{
+		std::cout << "No tetrahedra to import, start with --tet <file>" << std::endl;
+		return false;
+	}
+	BodyDescription body = defaultBody(tetBody);
+	body.file = tetFile;
+	SceneBodies scene = currentBodies();
+	return addTetBody(scene, body);
+}
 
-	// generate the spring network
-	for (unsigned int i = 0; i < massVec.size(); i++)
+// the plane, bodies and colliders of a description, a scene file's or a built in one's
+bool generateDescribedScene(const SceneDescription &description)
+{
+	planeHeight = description.planeHeight;
+	planeSize = description.planeSize;
+	SceneBodies scene = currentBodies();
+	if (!buildBodies(scene, description))
+		return false;
+	colliderSet.colliders = description.colliders;
+	colliderSet.fields = description.fields;
+	return true;
+}
+
+// everything the --scene file describes
+bool generateSceneFile()
+{
+	if (sceneFile.empty())
 	{
-		for (unsigned int j = i + 1; j < massVec.size(); j++)
-		{
-			float dist = distance(massVec[i].position, massVec[j].position);
-			if (dist < springDistance)
-			{
-				Spring s;
-				s.m1 = i;
-				s.m2 = j;
-				s.restLength = dist;
-				s.constant = springConstant;
-				springVec.push_back(s);
-			}
-		}
+		std::cout << "No scene file to read, start with --scene <file>" << std::endl;
+		return false;
 	}
+	if (!readSceneFile(sceneFile, sceneDescription))
+		return false;
+
+	solver = sceneDescription.solver;
+	if (!generateDescribedScene(sceneDescription))
+		return false;
+
+	std::cout	<< "Read " << sceneFile << ", " << massVec.size() << " masses, " << springVec.size() << " springs and "
+				<< colliderSet.colliders.size() << " colliders" << std::endl;
+	return true;
 }
 
-void generateClothTableSpringSystem()
+// rendering
+// every program and the shader files it is built from, a changed file rebuilds only the
+// programs that use it
+struct ShaderProgram
 {
-	int numOfLayers = userInput("Enter diameter of cloth: "),
-		springLayers = 2,
-		top = numOfLayers / 2,
-		bottom = -top;
-	float	massDistance = .005f,
-			massMass = .1f,
-		// equation of a sphere. all masses contained need to be connected to center mass
-		// + .01f for floating point error
-			springDistance = .01f + sqrt(3.f * pow(springLayers * massDistance, 2.f)),
-			springConstant = 2000.f;
-			
+	GLuint *program;
+	const char *vertex, *geometry, *fragment;
+};
 
+ShaderProgram shaderPrograms[] =
+{
+	{ &planeProgram,	"plane.vert",	"plane.geom",	"plane.frag" },
+	{ &springProgram,	"springs.vert",	NULL,			"springs.frag" },
+	{ &massProgram,		"masses.vert",	NULL,			"masses.frag" },
+	{ &clothProgram,	"cloth.vert",	NULL,			"cloth.frag" }
+};
+const int shaderProgramCount = sizeof(shaderPrograms) / sizeof(shaderPrograms[0]);
+
+GLuint buildShaderProgram(const ShaderProgram &shaders)
+{
+	return shaders.geometry ?
+		generateProgram(shaders.vertex, shaders.geometry, shaders.fragment) :
+		generateProgram(shaders.vertex, shaders.fragment);
+}
+
+// looked up once per link instead of by name every frame
+void findUniformLocations()
+{
+	planeHeightLocation = glGetUniformLocation(planeProgram, "height");
+	planeSizeLocation = glGetUniformLocation(planeProgram, "planeSize");
+	massRadiusLocation = glGetUniformLocation(massProgram, "radius");
+}
 
+void generateShaders()
+{
+	for (int i = 0; i < shaderProgramCount; i++)
+	{
+		// the old program goes first, reloading used to leak them
+		glDeleteProgram(*shaderPrograms[i].program);
+		*shaderPrograms[i].program = buildShaderProgram(shaderPrograms[i]);
+	}
+	findUniformLocations();
+}
 
-	// generate the network of masses
-	float x = bottom * massDistance;
-	for (float xLayer = 0; xLayer < numOfLayers; xLayer++)
+// rebuilds reloadShaders started, each swapped in by finishShaderReloads once it has linked
+struct ShaderReload
+{
+	int index;				// into shaderPrograms
+	ProgramBuild build;
+};
+std::vector<ShaderReload> shaderReloads;
+
+// called between frames, it only starts the rebuilds so the frames go on while they compile.
+// a file saved again before its last rebuild finished replaces that rebuild
+void reloadShaders(const std::vector<std::string> &changed)
+{
+	for (int i = 0; i < shaderProgramCount; i++)
 	{
-		float	y = bottom * massDistance,
-				z = bottom * massDistance;
-		for (int yLayer = 0; yLayer < numOfLayers; yLayer++)
+		const ShaderProgram &shaders = shaderPrograms[i];
+		bool affected = false;
+		for (unsigned int c = 0; c < changed.size() && !affected; c++)
+			affected =	changed[c] == shaders.vertex ||
+						changed[c] == shaders.fragment ||
+						(shaders.geometry && changed[c] == shaders.geometry);
+		if (!affected)
+			continue;
+
+		for (unsigned int r = 0; r < shaderReloads.size(); r++)
 		{
-			Mass m;
-			m.position = glm::vec3(x, y, z);
-			m.mass = massMass;
-			massVec.push_back(m);
-
-			y += massDistance;
-			z += massDistance;
+			if (shaderReloads[r].index != i)
+				continue;
+			discardProgram(shaderReloads[r].build);
+			shaderReloads.erase(shaderReloads.begin() + r);
+			break;
 		}
-		x += massDistance;
+		ShaderReload reload;
+		reload.index = i;
+		startProgram(reload.build, shaders.vertex, shaders.geometry, shaders.fragment);
+		shaderReloads.push_back(reload);
 	}
+}
 
-
-	// generate the spring network
-	for (unsigned int i = 0; i < massVec.size(); i++)
+// called every frame. a program is only replaced once its rebuild has linked, one that
+// fails keeps drawing with the old program and one still linking waits for a later frame
+void finishShaderReloads()
+{
+	bool replaced = false;
+	for (unsigned int r = 0; r < shaderReloads.size();)
 	{
-		for (unsigned int j = i + 1; j < massVec.size(); j++)
+		ShaderReload &reload = shaderReloads[r];
+		if (!programBuilt(reload.build))
 		{
-			float dist = distance(massVec[i].position, massVec[j].position);
-			if (dist < springDistance)
-			{
-				Spring s;
-				s.m1 = i;
-				s.m2 = j;
-				s.restLength = dist;
-				s.constant = springConstant;
-				springVec.push_back(s);
-			}
+			r++;
+			continue;
 		}
+
+		const ShaderProgram &shaders = shaderPrograms[reload.index];
+		if (finishProgram(reload.build))
+		{
+			glDeleteProgram(*shaders.program);
+			*shaders.program = reload.build.program;
+			replaced = true;
+			std::cout << "Reloaded " << shaders.vertex << std::endl;
+		}
+		else
+		{
+			glDeleteProgram(reload.build.program);
+			std::cout << "Kept the old " << shaders.vertex << " program" << std::endl;
+		}
+		shaderReloads.erase(shaderReloads.begin() + r);
 	}
+	if (replaced)
+		findUniformLocations();
 }
 
-
-// rendering
-void generateShaders()
+void watchShaders(const std::string &directory)
 {
-	planeProgram = generateProgram("shaders/plane.vert",
-									"shaders/plane.geom",
-									"shaders/plane.frag");
-	springProgram = generateProgram("shaders/springs.vert",
-									"shaders/springs.frag");
-	massProgram = generateProgram("shaders/masses.vert",
-									"shaders/masses.frag");
+	std::vector<std::string> names;
+	for (int i = 0; i < shaderProgramCount; i++)
+	{
+		names.push_back(shaderPrograms[i].vertex);
+		names.push_back(shaderPrograms[i].fragment);
+		if (shaderPrograms[i].geometry)
+			names.push_back(shaderPrograms[i].geometry);
+	}
+	startShaderWatcher(shaderWatcher, directory, names);
 }
 
 void renderPlane(GLuint program)
 {
     glUseProgram(program);
 
-    passBasicUniforms(program);
-	glUniform1f(glGetUniformLocation(program, "height"), planeHeight);
-	glUniform1f(glGetUniformLocation(program, "planeSize"), planeSize);
+	glUniform1f(planeHeightLocation, planeHeight);
+	glUniform1f(planeSizeLocation, planeSize);
 
 
     glDrawArrays(GL_POINTS, 0, 1);
@@ -338,31 +637,605 @@ void renderSprings(GLuint program)
 	glBindVertexArray(springVertexArray);
 	glUseProgram(program);
 
-	passBasicUniforms(program);
-	
 	glLineWidth(2);
-	glDrawArrays(GL_LINES, 0, 2 * springVec.size());
+	glDrawElements(GL_LINES, 2 * springVec.size(), GL_UNSIGNED_INT, NULL);
+
+	glBindVertexArray(0);
+}
+
+void renderCloth(GLuint program)
+{
+	glBindVertexArray(clothVertexArray);
+	glUseProgram(program);
+
+	glDrawElements(GL_TRIANGLES, clothMesh.triangles.size(), GL_UNSIGNED_INT, NULL);
 
 	glBindVertexArray(0);
 }
 
+// a camera facing square per mass, shaded as a sphere in the fragment shader
 void renderMasses(GLuint program)
 {
 	glBindVertexArray(massVertexArray);
 	glUseProgram(program);
 
-	passBasicUniforms(program);
-
-	glPointSize(10);
-	glDrawArrays(GL_POINTS, 0, massVec.size());
+	glUniform1f(massRadiusLocation, massRadius);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, massVec.size());
 
 	glBindVertexArray(0);
 }
 
 
+// everything derived from a freshly generated scene
+void prepareScene()
+{
+	springKernel = selectSpringKernel(massVec, springVec, planeSize);
+	// only a scene file may ask for self collision, every cloth otherwise collides with its own triangles
+	solver.selfCollision = state == sceneFileState && sceneDescription.solver.selfCollision;
+
+	buildMeshEdges(clothMesh, (unsigned int)massVec.size());
+	buildBVH(clothBVH, massVec, clothMesh, solver.thickness);
+	solver.meshCollision = (state != sceneFileState || sceneDescription.solver.meshCollision) && !clothMesh.triangles.empty();
+
+	buildTopology(springTopology, (unsigned int)massVec.size(), springVec);
+	generateSpringBuffer();
+	generateClothBuffers();
+}
+
+
+// nothing loaded, the first scene instead
+void loadFailed()
+{
+	massVec.clear();
+	springVec.clear();
+	clothMesh.triangles.clear();
+	bodyVec.clear();
+	colliderSet.colliders.clear();
+	state = singleSpringState;
+	planeHeight = defaultPlaneHeight;
+	planeSize = defaultPlaneSize;
+	generateSingleSpringSystem();
+}
+
+// rebuilds the scene for the current state
+void changeScene()
+{
+	// a recording holds one scene
+	if (recorder.recording)
+	{
+		stopRecording(recorder);
+		std::cout << "Recording stopped for the new scene" << std::endl;
+	}
+	if (exporter.exporting)
+	{
+		stopExport(exporter);
+		std::cout << "Export stopped for the new scene" << std::endl;
+	}
+
+	massVec.clear();
+	springVec.clear();
+	clothMesh.triangles.clear();
+	colliderSet.colliders.clear();
+	colliderSet.fields.clear();
+	bodyVec.clear();
+	planeHeight = defaultPlaneHeight;
+	planeSize = defaultPlaneSize;
+
+	// a scene file's solver settings do not outlast it, tearing stays as it was toggled
+	float tearThreshold = solver.tearThreshold;
+	solver = SolverSettings();
+	solver.tearThreshold = tearThreshold;
+	switch (state)
+	{
+		case (singleSpringState):
+			generateSingleSpringSystem();
+			planeHeight = abs(planeHeight);
+			break;
+		case(multiSpringState):
+			generateMultiSpringSystem();
+			planeHeight = abs(planeHeight);
+			break;
+		case(boxSpringState):
+			generateCubeSpringSystem();
+			planeHeight = -abs(planeHeight);
+			break;
+		case(clothHangState):
+			generateDescribedScene(clothHangScene(userInput("Enter diameter of cloth: ", defaultClothLayers)));
+			break;
+		case(clothTableState):
+			generateDescribedScene(clothTableScene(userInput("Enter diameter of cloth: ", defaultClothLayers)));
+			break;
+		case(clothDrapeState):
+			generateDescribedScene(clothDrapeScene(userInput("Enter diameter of cloth: ", defaultClothLayers)));
+			break;
+		case(cubePileState):
+			planeHeight = -abs(planeHeight);
+			generateCubePileSystem();
+			break;
+		case(meshState):
+			planeHeight = -clothPlaneHeight;
+			if (generateMeshSystem())
+				break;
+			loadFailed();
+			break;
+		case(tetState):
+			planeHeight = -abs(planeHeight);
+			if (generateTetSystem())
+				break;
+			loadFailed();
+			break;
+		case(sceneFileState):
+			if (generateSceneFile())
+				break;
+			loadFailed();
+			break;
+		default:
+			generateSingleSpringSystem();
+			break;
+	}
+	prepareScene();
+	streamScene(streamServer, massVec, springVec, clothMesh.triangles);
+	previousPositions.clear();
+	simulationLag = 0.0;
+	simulationFrame = 0;
+	stateChange = false;
+}
+
+// one frame of simulation
+void stepSimulation()
+{
+	// already moving at 60 steps/second
+	for (int i = 0; i < timeStep; i++)
+	{
+		beginColliderStep(colliderSet, massVec);
+		springKernel(massVec, springVec, planeHeight, planeSize, solver.damping);
+		collideColliders(massVec, colliderSet);
+		if (bodyVec.size() > 1)
+			collideBodies(massVec, bodyVec, broadphase, solver.contactDistance);
+		// one or the other, mass against mass stands in for the triangles when asked for
+		if (solver.selfCollision)
+			selfCollision(massVec, solver.thickness);
+		else if (solver.meshCollision)
+			meshCollision(massVec, clothMesh, clothBVH, solver.thickness);
+		if (solver.tearThreshold > 0.f)
+			tearSprings(springTopology, massVec, springVec, solver.tearThreshold);
+	}
+	simulationFrame++;
+	recordFrame(recorder, massVec);
+	publishState(sharedState, massVec, simulationFrame);
+	streamFrame(streamServer, massVec);
+	exportFrame(exporter, simulationFrame, massVec, springVec, clothMesh.triangles);
+}
 
-int main()
+void snapshotPositions()
 {
+	const int massCount = (int)massVec.size();
+	previousPositions.resize(massCount);
+	#pragma omp parallel for
+	for (int i = 0; i < massCount; i++)
+		previousPositions[i] = massVec[i].position;
+}
+
+// physics at its fixed rate behind a render loop running at its own. whole physics frames
+// are taken out of the wall time that passed and the remainder places the drawn masses
+// between the last two states, a slow frame costs smoothness but never simulated time
+void advanceSimulation(double elapsed)
+{
+	simulationLag += min(elapsed, maxFrameLag);
+	int steps = (int)(simulationLag / physicsFrame);
+	simulationLag -= steps * physicsFrame;
+
+	for (int i = 0; i < steps; i++)
+	{
+		if (i == steps - 1)
+			snapshotPositions();
+		stepSimulation();
+	}
+	renderAlpha = (float)(simulationLag / physicsFrame);
+}
+
+// playback
+
+// the first frame's distances stand in for the rest lengths, the recording only has the indices
+bool loadPlayback(const std::string &filename)
+{
+	if (!openTrajectory(player, filename))
+		return false;
+
+	// the scene's own setup for the plane, then its masses traded for the recording's
+	changeScene();
+	const TrajectoryHeader &header = player.header;
+	massVec.assign(header.massCount, Mass());
+	for (unsigned int i = 0; i < header.massCount; i++)
+		massVec[i].position = player.positions[i];
+	springVec.clear();
+	for (unsigned int i = 0; i < header.springCount; i++)
+	{
+		Spring s;
+		s.m1 = player.springs[2 * i];
+		s.m2 = player.springs[2 * i + 1];
+		if (s.m1 >= header.massCount || s.m2 >= header.massCount)
+			continue;
+		s.restLength = length(massVec[s.m1].position - massVec[s.m2].position);
+		springVec.push_back(s);
+	}
+	clothMesh.triangles.assign(player.triangles, player.triangles + 3 * header.triangleCount);
+	bodyVec.clear();
+	prepareScene();
+	streamScene(streamServer, massVec, springVec, clothMesh.triangles);
+
+	playback = true;
+	playbackFrame = 0.0;
+	std::cout << "Playing " << filename << ", " << player.frameCount << " frames of " << header.massCount << " masses" << std::endl;
+	return true;
+}
+
+// moves the recording on by elapsed wall time at the playback speed, looping at either
+// end. positions come straight out of the file, velocities from the frames either side
+// so the masses still color by speed
+void advancePlayback(double elapsed)
+{
+	if (simulation)
+		playbackFrame += elapsed / physicsFrame * playbackSpeed;
+	playbackFrame = fmod(playbackFrame, (double)player.frameCount);
+	if (playbackFrame < 0.0)
+		playbackFrame += player.frameCount;
+
+	int shown = player.frame;
+	if (!seekTrajectory(player, (unsigned int)playbackFrame) || player.frame == shown)
+		return;
+
+	const int massCount = (int)massVec.size();
+	float frameTime = (float)(std::abs(player.frame - shown) * physicsFrame);
+	#pragma omp parallel for
+	for (int i = 0; i < massCount; i++)
+	{
+		massVec[i].velocity = (player.positions[i] - massVec[i].position) / frameTime;
+		massVec[i].position = player.positions[i];
+	}
+	publishState(sharedState, massVec, (unsigned int)player.frame);
+	streamFrame(streamServer, massVec);
+	exportFrame(exporter, (unsigned int)player.frame, massVec, springVec, clothMesh.triangles);
+}
+
+// checkpoints
+
+SceneState currentScene()
+{
+	SceneState scene = {	state, simulationFrame, planeHeight, planeSize, solver,
+							massVec, springVec, clothMesh, colliderSet, bodyVec, broadphase, clothBVH };
+	return scene;
+}
+
+bool saveCheckpoint(const std::string &filename)
+{
+	if (playback)
+		return false;
+	if (!writeCheckpoint(filename, currentScene()))
+		return false;
+	std::cout << "Saved frame " << simulationFrame << " to " << filename << std::endl;
+	return true;
+}
+
+// the saved scene in place of building one, everything derived from it is rebuilt but the
+// BVH and the solver settings come back as they were
+bool restoreCheckpoint(const std::string &filename)
+{
+	if (playback)
+		return false;
+	SceneState scene = currentScene();
+	if (!readCheckpoint(filename, scene))
+		return false;
+	if (recorder.recording)
+		stopRecording(recorder);
+
+	springKernel = selectSpringKernel(massVec, springVec, planeSize);
+	buildMeshEdges(clothMesh, (unsigned int)massVec.size());
+	buildTopology(springTopology, (unsigned int)massVec.size(), springVec);
+	generateSpringBuffer();
+	generateClothBuffers();
+	streamScene(streamServer, massVec, springVec, clothMesh.triangles);
+	previousPositions.clear();
+	simulationLag = 0.0;
+	stateChange = false;
+	std::cout << "Restored frame " << simulationFrame << " from " << filename << std::endl;
+	return true;
+}
+
+void renderScene()
+{
+	updateCamera();
+
+	glEnable(GL_DEPTH_TEST);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glClearBufferfv(GL_COLOR, 0, clearColor);
+
+	if (planeSize > 0.f)
+		renderPlane(planeProgram);
+	// torn springs do not cut the surface, switch back to springs to watch tearing
+	if (clothSurface && !clothMesh.triangles.empty())
+		renderCloth(clothProgram);
+	else
+		renderSprings(springProgram);
+	if (clothMesh.triangles.empty())	// only render masses if the object is not a cloth
+		renderMasses(massProgram);
+
+	glDisable(GL_DEPTH_TEST);
+}
+
+
+// command line
+struct RunOptions
+{
+	RunOptions() :	headless(false),
+					frames(600),
+					width(WINDOW_WIDTH),
+					height(WINDOW_HEIGHT),
+					format(y4mFrames),
+					output("frames"),
+					checkpointInterval(0),
+					viewerDelay(0),
+					exportFormat(vtkExport),
+					exportInterval(1),
+					batchThreads(0),
+					checkPlane(false) { }
+	bool headless;				// render to files instead of a window
+	unsigned int frames;
+	unsigned int width, height;
+	int format;
+	std::string output;			// file name without its extension
+	std::string shaders;		// override directory, watched for changes when set
+	std::string record;			// trajectory file, recorded from the first scene
+	std::string play;			// trajectory file shown instead of simulating
+	std::string checkpoint;		// where checkpoints are saved, none when headless and not set
+	unsigned int checkpointInterval;	// physics frames between headless checkpoints, 0 only at the end
+	std::string restore;		// checkpoint to start from instead of building the scene
+	std::string share;			// shared memory segment the masses are published to
+	std::string stream;			// socket path or port viewers connect to
+	std::string connect;		// run as a stand in viewer of this address instead
+	unsigned int viewerDelay;	// ms the stand in viewer sleeps after every read
+	std::string exportPath;		// file names for exported frames, without number or extension
+	int exportFormat;
+	unsigned int exportInterval;
+	std::string batch;			// scene file whose sweep is run instead of opening a window
+	unsigned int batchThreads;	// 0 is one per core
+	bool checkPlane;			// a headless run fails once a mass is below the plane
+};
+
+void printUsage(const char *program)
+{
+	std::cout	<< "Usage: " << program << " [options]" << std::endl
+				<< "  --shaders <dir>         load shaders from here before the built in ones," << std::endl
+				<< "                          reloading them when they change" << std::endl
+				<< "  --shader-cache <dir>    keep linked shader programs here, for faster starts" << std::endl
+				<< "  --state <n>             scene to start in, the number keys' states" << std::endl
+				<< "  --headless <frames>     render frames to files without a window" << std::endl
+				<< "  --output <name>         file name for the frames, without extension" << std::endl
+				<< "  --format <raw|y4m|png>  frame file format" << std::endl
+				<< "  --size <width>x<height> frame size" << std::endl
+				<< "  --layers <n>            size of the number key scenes instead of asking, the" << std::endl
+				<< "                          chain's masses, cube layers, cubes or cloth diameter" << std::endl
+				<< "  --obj <file>            import a Wavefront OBJ as cloth, the 8 key's scene" << std::endl
+				<< "  --tet <file>            import TetGen .node and .ele files as a soft body," << std::endl
+				<< "                          the 9 key's scene" << std::endl
+				<< "  --scene <file>          build the scene a scene file describes, the 0 key's" << std::endl
+				<< "  --record <file>         record the trajectory of the first scene" << std::endl
+				<< "  --play <file>           play a recorded trajectory back, the state sets the plane" << std::endl
+				<< "  --checkpoint <file>     where checkpoints go, saved at the end of a headless run" << std::endl
+				<< "  --checkpoint-every <n>  also save one every n physics frames when headless" << std::endl
+				<< "  --restore <file>        carry on from a checkpoint" << std::endl
+				<< "  --share <name>          publish the masses to a shared memory segment after" << std::endl
+				<< "                          every frame, /physics-sim for instance" << std::endl
+				<< "  --stream <path|port>    stream positions to viewers on a socket or local port" << std::endl
+				<< "  --connect <path|port>   be a viewer of a stream, saving it with --record" << std::endl
+				<< "  --viewer-delay <ms>     make that viewer slow, to watch frames being dropped" << std::endl
+				<< "  --export <name>         write masses and springs for ParaView, name_00042.vtk" << std::endl
+				<< "  --export-format <vtk|ply>" << std::endl
+				<< "  --export-every <n>      export every nth physics frame" << std::endl
+				<< "  --batch <file>          run every combination of a scene file's [sweep] with no" << std::endl
+				<< "                          window, a row of results per run in <output>.csv" << std::endl
+				<< "  --threads <n>           batch runs at once, one per core when not set" << std::endl
+				<< "  --check-plane           fail a headless run once a mass is below the plane" << std::endl;
+}
+
+bool parseOptions(int argc, char** argv, RunOptions &options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--state" && hasValue)
+			state = atoi(argv[++i]);
+		else if (arg == "--shaders" && hasValue)
+		{
+			options.shaders = argv[++i];
+			setShaderDirectory(options.shaders);
+		}
+		else if (arg == "--shader-cache" && hasValue)
+			setProgramCacheDirectory(argv[++i]);
+		else if (arg == "--headless" && hasValue)
+		{
+			options.headless = true;
+			options.frames = (unsigned int)atoi(argv[++i]);
+			askSceneSize = false;
+		}
+		else if (arg == "--layers" && hasValue)
+			sceneSize = atoi(argv[++i]);
+		else if (arg == "--obj" && hasValue)
+		{
+			meshFile = argv[++i];
+			state = meshState;
+		}
+		else if (arg == "--tet" && hasValue)
+		{
+			tetFile = argv[++i];
+			state = tetState;
+		}
+		else if (arg == "--scene" && hasValue)
+		{
+			sceneFile = argv[++i];
+			state = sceneFileState;
+		}
+		else if (arg == "--record" && hasValue)
+			options.record = argv[++i];
+		else if (arg == "--play" && hasValue)
+			options.play = argv[++i];
+		else if (arg == "--checkpoint" && hasValue)
+			options.checkpoint = argv[++i];
+		else if (arg == "--checkpoint-every" && hasValue)
+			options.checkpointInterval = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--restore" && hasValue)
+			options.restore = argv[++i];
+		else if (arg == "--share" && hasValue)
+			options.share = argv[++i];
+		else if (arg == "--stream" && hasValue)
+			options.stream = argv[++i];
+		else if (arg == "--connect" && hasValue)
+			options.connect = argv[++i];
+		else if (arg == "--viewer-delay" && hasValue)
+			options.viewerDelay = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--export" && hasValue)
+			options.exportPath = argv[++i];
+		else if (arg == "--export-format" && hasValue)
+		{
+			std::string format = argv[++i];
+			if (format == "vtk")		options.exportFormat = vtkExport;
+			else if (format == "ply")	options.exportFormat = plyExport;
+			else return false;
+		}
+		else if (arg == "--export-every" && hasValue)
+			options.exportInterval = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--batch" && hasValue)
+			options.batch = argv[++i];
+		else if (arg == "--threads" && hasValue)
+			options.batchThreads = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--check-plane")
+			options.checkPlane = true;
+		else if (arg == "--output" && hasValue)
+			options.output = argv[++i];
+		else if (arg == "--format" && hasValue)
+		{
+			std::string format = argv[++i];
+			if (format == "raw")		options.format = rawFrames;
+			else if (format == "y4m")	options.format = y4mFrames;
+			else if (format == "png")	options.format = pngFrames;
+			else return false;
+		}
+		else if (arg == "--size" && hasValue)
+		{
+			if (sscanf(argv[++i], "%ux%u", &options.width, &options.height) != 2 || !options.width || !options.height)
+				return false;
+		}
+		else
+			return false;
+	}
+	return true;
+}
+
+// renders straight into files, the frames leave the GPU through pixel buffers and are
+// written on their own thread so neither the readback nor the disk holds up the loop
+bool runHeadless(const RunOptions &options)
+{
+	if (!createOffscreenContext())
+		return false;
+	printOpenGLVersion(GL_MAJOR_VERSION, GL_MINOR_VERSION, GL_SHADING_LANGUAGE_VERSION);
+
+	generateShaders();
+	generateBuffers();
+	bool loaded;
+	if (!options.play.empty())
+		loaded = loadPlayback(options.play);
+	else if (!options.restore.empty())
+		loaded = restoreCheckpoint(options.restore);
+	else
+	{
+		changeScene();
+		loaded = true;
+	}
+	if (!loaded)
+	{
+		destroyOffscreenContext();
+		return false;
+	}
+	aspectRatio = (float)options.width / (float)options.height;
+	if (!options.record.empty() && !playback)
+		startRecording(recorder, options.record, massVec, springVec, clothMesh.triangles);
+	if (!options.share.empty())
+		openSharedState(sharedState, options.share, (unsigned int)massVec.size());
+	if (!options.stream.empty() && startStreamServer(streamServer, options.stream))
+		streamScene(streamServer, massVec, springVec, clothMesh.triangles);
+	if (!options.exportPath.empty())
+		startExport(exporter, options.exportPath, options.exportFormat, options.exportInterval);
+
+	OffscreenTarget target;
+	if (!createOffscreenTarget(target, options.width, options.height, antiAliasing, options.format, options.output))
+	{
+		destroyOffscreenContext();
+		return false;
+	}
+
+	bool aboveThePlane = true;
+	for (unsigned int frame = 0; frame < options.frames && aboveThePlane; frame++)
+	{
+		generateMassBuffer();
+		generateNormalBuffer();
+		updateSpringBuffer();
+
+		beginOffscreenFrame(target);
+		renderScene();
+		endOffscreenFrame(target);
+
+		if (playback)
+			advancePlayback(physicsFrame);
+		else
+		{
+			stepSimulation();
+			if (!options.checkpoint.empty() && options.checkpointInterval && simulationFrame % options.checkpointInterval == 0)
+				saveCheckpoint(options.checkpoint);
+		}
+		// a scene without a plane has nothing to be below
+		if (options.checkPlane && planeSize > 0.f)
+		{
+			float lowest = planeHeight;
+			for (unsigned int i = 0; i < massVec.size(); i++)
+				lowest = min(lowest, massVec[i].position.y);
+			if (lowest < planeHeight)
+			{
+				std::cout << "A MASS FELL BELOW THE PLANE AT FRAME " << frame + 1 << ", " << lowest << " UNDER " << planeHeight << std::endl;
+				aboveThePlane = false;
+			}
+		}
+	}
+
+	// the last frame, unless the interval just saved it
+	if (!options.checkpoint.empty() && !playback && !(options.checkpointInterval && simulationFrame % options.checkpointInterval == 0))
+		saveCheckpoint(options.checkpoint);
+	stopRecording(recorder);
+	closeTrajectory(player);
+	closeSharedState(sharedState);
+	stopStreamServer(streamServer);
+	stopExport(exporter);
+	destroyOffscreenTarget(target);
+	destroyOffscreenContext();
+	return aboveThePlane;
+}
+
+
+int main(int argc, char** argv)
+{
+	RunOptions options;
+	if (!parseOptions(argc, argv, options))
+	{
+		printUsage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	if (!options.connect.empty())
+		exit(runStreamClient(options.connect, options.record, options.viewerDelay) ? EXIT_SUCCESS : EXIT_FAILURE);
+	if (!options.batch.empty())
+		exit(runBatch(options.batch, options.output, options.batchThreads) ? EXIT_SUCCESS : EXIT_FAILURE);
+	if (options.headless)
+		exit(runHeadless(options) ? EXIT_SUCCESS : EXIT_FAILURE);
+
 	if (!glfwInit())
 	{
 		std::cout << "Failed to initialize GLFW" << std::endl;
@@ -394,85 +1267,93 @@ int main()
 	printOpenGLVersion(GL_MAJOR_VERSION, GL_MINOR_VERSION, GL_SHADING_LANGUAGE_VERSION);
 
     generateShaders();
+	generateBuffers();
+	if (!options.shaders.empty())
+		watchShaders(options.shaders);
 
-	generateSingleSpringSystem();
+	if (!options.play.empty())
+	{
+		if (!loadPlayback(options.play))
+			exit(EXIT_FAILURE);
+	}
+	else if (options.restore.empty() || !restoreCheckpoint(options.restore))
+		changeScene();
+	std::string checkpointFile = options.checkpoint.empty() ? defaultCheckpoint : options.checkpoint;
+	if (!options.record.empty() && !playback)
+		startRecording(recorder, options.record, massVec, springVec, clothMesh.triangles);
+	if (!options.share.empty())
+		openSharedState(sharedState, options.share, (unsigned int)massVec.size());
+	if (!options.stream.empty() && startStreamServer(streamServer, options.stream))
+		streamScene(streamServer, massVec, springVec, clothMesh.triangles);
+	if (!options.exportPath.empty())
+		startExport(exporter, options.exportPath, options.exportFormat, options.exportInterval);
 
 
     glfwSwapInterval(1);
 
+	double lastFrame = glfwGetTime();
 	while (!glfwWindowShouldClose(window))
 	{
 		generateMassBuffer();
-		generateSpringBuffer();
+		generateNormalBuffer();
+		updateSpringBuffer();
 
 
 		// the rendering
-        glEnable(GL_DEPTH_TEST);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glClearBufferfv(GL_COLOR, 0, clearColor);
-
-		renderPlane(planeProgram);
-		renderSprings(springProgram);
-		if (state <= boxSpringState)	// only render masses if the object is not a cloth
-			renderMasses(massProgram);
-		
-        glDisable(GL_DEPTH_TEST);
+		renderScene();
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 		
 
 
-		// if we request a new scene
-		if (stateChange)
+		// shaders saved since the last frame, and rebuilds that have finished linking
+		takeChangedShaders(shaderWatcher, changedShaders);
+		if (!changedShaders.empty())
+			reloadShaders(changedShaders);
+		finishShaderReloads();
+
+
+		double now = glfwGetTime(),
+				elapsed = now - lastFrame;
+		lastFrame = now;
+
+		// between frames so neither lands halfway through a step
+		if (checkpointSave)
+			saveCheckpoint(checkpointFile);
+		if (checkpointRestore)
+			restoreCheckpoint(checkpointFile);
+		checkpointSave = checkpointRestore = false;
+
+		// a recording plays in place of the simulation, its one scene stays put
+		if (playback)
 		{
-			massVec.clear();
-			springVec.clear();
-			planeHeight = defaultPlaneHeight;
-			planeHeight = defaultPlaneHeight;
-			switch (state)
-			{
-				case (singleSpringState):
-					generateSingleSpringSystem();
-					planeHeight = abs(planeHeight);
-					break;
-				case(multiSpringState):
-					generateMultiSpringSystem();
-					planeHeight = abs(planeHeight);
-					break;
-				case(boxSpringState):
-					generateCubeSpringSystem();
-					planeHeight = -abs(planeHeight);
-					break;
-				case(clothHangState):
-					planeSize = clothPlaneSize;
-					planeHeight = clothPlaneHeight;
-					generateClothHangSpringSystem();
-					planeHeight = -abs(planeHeight);
-					break;
-				case(clothTableState):
-					planeSize = clothPlaneSize;
-					planeHeight = clothPlaneHeight;
-					generateClothTableSpringSystem();
-					planeHeight = -abs(planeHeight);
-					break;
-				default:
-					generateSingleSpringSystem();
-					break;
-			}
 			stateChange = false;
+			advancePlayback(elapsed);
 		}
+		// if we request a new scene
+		else if (stateChange)
+			changeScene();
 		// run physics sim unless paused
+		else if (simulation && decoupledRendering)
+			advanceSimulation(elapsed);
 		else if (simulation)
 		{
-			// already moving at 60 steps/second
-			for (int i = 0; i < timeStep; i++)
-				springSystem(massVec, springVec, planeHeight, planeSize);
+			stepSimulation();
+			previousPositions.clear();
 		}
+		else
+			renderAlpha = 1.f;
 	}
 
 
 	// Shutdow the program
+	stopRecording(recorder);
+	closeTrajectory(player);
+	closeSharedState(sharedState);
+	stopStreamServer(streamServer);
+	stopExport(exporter);
+	stopShaderWatcher(shaderWatcher);
 	glfwDestroyWindow(window);
 	glfwTerminate();
 	exit(EXIT_SUCCESS);
-}
\ No newline at end of file
+}
@@ -0,0 +1,507 @@
+#include "Offscreen.h"
+#include <cstring>
+
+// away from Windows the context comes from EGL wherever its header is found, with no
+// surface at all, which Mesa also provides on its CPU rasterizer, so a display-less machine
+// needs no window system. OFFSCREEN_GLFW keeps to the hidden GLFW window, which is also
+// what a machine without libEGL falls back to
+#if !defined(OFFSCREEN_EGL) && !defined(OFFSCREEN_GLFW) && !defined(_WIN32) && defined(__has_include)
+#if __has_include(<EGL/egl.h>)
+#define OFFSCREEN_EGL
+#endif
+#endif
+
+#ifdef OFFSCREEN_EGL
+// libEGL is opened when the context is made rather than linked, nothing has to link it and
+// calling EGL without going through the functions below does not compile
+#define EGL_EGL_PROTOTYPES 0
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <dlfcn.h>
+
+void *eglLibrary = NULL;
+PFNEGLGETPROCADDRESSPROC	eglGetProcAddressFunction;
+PFNEGLGETDISPLAYPROC		eglGetDisplayFunction;
+PFNEGLINITIALIZEPROC		eglInitializeFunction;
+PFNEGLBINDAPIPROC			eglBindAPIFunction;
+PFNEGLCHOOSECONFIGPROC		eglChooseConfigFunction;
+PFNEGLCREATECONTEXTPROC		eglCreateContextFunction;
+PFNEGLMAKECURRENTPROC		eglMakeCurrentFunction;
+PFNEGLDESTROYCONTEXTPROC	eglDestroyContextFunction;
+PFNEGLTERMINATEPROC			eglTerminateFunction;
+
+EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+EGLContext eglContext = EGL_NO_CONTEXT;
+#endif
+
+GLFWwindow *hiddenWindow = NULL;
+
+
+#ifdef OFFSCREEN_EGL
+bool loadEGL()
+{
+	eglLibrary = dlopen("libEGL.so.1", RTLD_NOW | RTLD_LOCAL);
+	if (!eglLibrary)
+		return false;
+
+	eglGetProcAddressFunction = (PFNEGLGETPROCADDRESSPROC)dlsym(eglLibrary, "eglGetProcAddress");
+	eglGetDisplayFunction = (PFNEGLGETDISPLAYPROC)dlsym(eglLibrary, "eglGetDisplay");
+	eglInitializeFunction = (PFNEGLINITIALIZEPROC)dlsym(eglLibrary, "eglInitialize");
+	eglBindAPIFunction = (PFNEGLBINDAPIPROC)dlsym(eglLibrary, "eglBindAPI");
+	eglChooseConfigFunction = (PFNEGLCHOOSECONFIGPROC)dlsym(eglLibrary, "eglChooseConfig");
+	eglCreateContextFunction = (PFNEGLCREATECONTEXTPROC)dlsym(eglLibrary, "eglCreateContext");
+	eglMakeCurrentFunction = (PFNEGLMAKECURRENTPROC)dlsym(eglLibrary, "eglMakeCurrent");
+	eglDestroyContextFunction = (PFNEGLDESTROYCONTEXTPROC)dlsym(eglLibrary, "eglDestroyContext");
+	eglTerminateFunction = (PFNEGLTERMINATEPROC)dlsym(eglLibrary, "eglTerminate");
+	if (eglGetProcAddressFunction && eglGetDisplayFunction && eglInitializeFunction && eglBindAPIFunction &&
+		eglChooseConfigFunction && eglCreateContextFunction && eglMakeCurrentFunction &&
+		eglDestroyContextFunction && eglTerminateFunction)
+		return true;
+
+	dlclose(eglLibrary);
+	eglLibrary = NULL;
+	return false;
+}
+
+void destroyEGLContext()
+{
+	if (eglDisplay != EGL_NO_DISPLAY)
+	{
+		eglMakeCurrentFunction(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (eglContext != EGL_NO_CONTEXT)
+			eglDestroyContextFunction(eglDisplay, eglContext);
+		eglTerminateFunction(eglDisplay);
+	}
+	eglContext = EGL_NO_CONTEXT;
+	eglDisplay = EGL_NO_DISPLAY;
+	if (eglLibrary)
+		dlclose(eglLibrary);
+	eglLibrary = NULL;
+}
+
+bool createEGLContext()
+{
+	if (!loadEGL())
+	{
+		std::cout << "No libEGL to load" << std::endl;
+		return false;
+	}
+
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddressFunction("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay)
+		eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (eglDisplay == EGL_NO_DISPLAY)
+		eglDisplay = eglGetDisplayFunction(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (eglDisplay == EGL_NO_DISPLAY || !eglInitializeFunction(eglDisplay, &major, &minor))
+	{
+		std::cout << "Failed to initialize EGL" << std::endl;
+		eglDisplay = EGL_NO_DISPLAY;
+		destroyEGLContext();
+		return false;
+	}
+
+	// no surface is ever made, any config that renders OpenGL will do
+	const EGLint configAttributes[] = {	EGL_SURFACE_TYPE, 0,
+										EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+										EGL_NONE };
+	const EGLint contextAttributes[] = {	EGL_CONTEXT_MAJOR_VERSION, 4,
+											EGL_CONTEXT_MINOR_VERSION, 3,
+											EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+											EGL_NONE };
+	EGLConfig config;
+	EGLint configs = 0;
+	if (!eglBindAPIFunction(EGL_OPENGL_API) ||
+		!eglChooseConfigFunction(eglDisplay, configAttributes, &config, 1, &configs) || configs == 0 ||
+		(eglContext = eglCreateContextFunction(eglDisplay, config, EGL_NO_CONTEXT, contextAttributes)) == EGL_NO_CONTEXT ||
+		!eglMakeCurrentFunction(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext))
+	{
+		std::cout << "Failed to create EGL context" << std::endl;
+		destroyEGLContext();
+		return false;
+	}
+
+	if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddressFunction))
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		destroyEGLContext();
+		return false;
+	}
+	return true;
+}
+#endif
+
+bool createWindowContext()
+{
+	if (!glfwInit())
+	{
+		std::cout << "Failed to initialize GLFW" << std::endl;
+		return false;
+	}
+	glfwSetErrorCallback(errorCallback);
+
+	glfwWindowHint(GLFW_VISIBLE, false);
+	hiddenWindow = glfwCreateWindow(1, 1, "Physics Sim", NULL, NULL);
+	if (!hiddenWindow)
+	{
+		std::cout << "Failed to create window" << std::endl;
+		glfwTerminate();
+		return false;
+	}
+	glfwMakeContextCurrent(hiddenWindow);
+
+	if (!gladLoadGL())
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		destroyOffscreenContext();
+		return false;
+	}
+	return true;
+}
+
+bool createOffscreenContext()
+{
+#ifdef OFFSCREEN_EGL
+	if (createEGLContext())
+		return true;
+	std::cout << "Trying a hidden window instead" << std::endl;
+#endif
+	return createWindowContext();
+}
+
+void destroyOffscreenContext()
+{
+#ifdef OFFSCREEN_EGL
+	if (eglLibrary)
+	{
+		destroyEGLContext();
+		return;
+	}
+#endif
+	if (hiddenWindow)
+		glfwDestroyWindow(hiddenWindow);
+	hiddenWindow = NULL;
+	glfwTerminate();
+}
+
+
+// frame encoding, all of it runs on the writer thread
+// the pixels arrive as GL reads them, bottom row first
+
+void writeRawFrame(FILE *stream, const WriteJob &job, void *context)
+{
+	const OffscreenTarget &target = *(const OffscreenTarget*)context;
+	size_t row = 4 * target.width;
+	for (unsigned int y = target.height; y-- > 0;)
+		fwrite(&job.data[y * row], 1, row, stream);
+}
+
+void writeY4MFrame(FILE *stream, const WriteJob &job, void *context)
+{
+	OffscreenTarget &target = *(OffscreenTarget*)context;
+	unsigned int pixels = target.width * target.height;
+	target.encoded.resize(3 * pixels);
+
+	// BT.601 studio range, each plane top row first
+	unsigned char	*luma = (unsigned char*)&target.encoded[0],
+					*blue = luma + pixels,
+					*red = blue + pixels;
+	for (unsigned int y = 0; y < target.height; y++)
+	{
+		const unsigned char *row = (const unsigned char*)&job.data[4 * (target.height - 1 - y) * target.width];
+		for (unsigned int x = 0; x < target.width; x++, row += 4)
+		{
+			int r = row[0], g = row[1], b = row[2];
+			unsigned int i = y * target.width + x;
+			luma[i] = (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+			blue[i] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+			red[i] = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+		}
+	}
+
+	fputs("FRAME\n", stream);
+	fwrite(&target.encoded[0], 1, target.encoded.size(), stream);
+}
+
+unsigned int crcTable[256];
+
+void buildCrcTable()
+{
+	for (unsigned int n = 0; n < 256; n++)
+	{
+		unsigned int c = n;
+		for (int k = 0; k < 8; k++)
+			c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+		crcTable[n] = c;
+	}
+}
+
+unsigned int updateCrc(unsigned int crc, const unsigned char *data, size_t length)
+{
+	for (size_t i = 0; i < length; i++)
+		crc = crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+// 5552 bytes is the most that can be summed before b could overflow
+void updateAdler(unsigned int &a, unsigned int &b, const unsigned char *data, size_t length)
+{
+	while (length > 0)
+	{
+		size_t run = length < 5552 ? length : 5552;
+		for (size_t i = 0; i < run; i++)
+		{
+			a += data[i];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+		data += run;
+		length -= run;
+	}
+}
+
+// writes bytes into the open chunk, keeping its crc
+void chunkWrite(FILE *file, unsigned int &crc, const void *data, size_t length)
+{
+	crc = updateCrc(crc, (const unsigned char*)data, length);
+	fwrite(data, 1, length, file);
+}
+
+void bigEndian(unsigned char *out, unsigned int value)
+{
+	out[0] = (unsigned char)(value >> 24);
+	out[1] = (unsigned char)(value >> 16);
+	out[2] = (unsigned char)(value >> 8);
+	out[3] = (unsigned char)value;
+}
+
+void beginChunk(FILE *file, unsigned int &crc, const char *type, unsigned int length)
+{
+	unsigned char header[4];
+	bigEndian(header, length);
+	fwrite(header, 1, 4, file);
+	crc = 0xffffffffu;
+	chunkWrite(file, crc, type, 4);
+}
+
+void endChunk(FILE *file, unsigned int crc)
+{
+	unsigned char footer[4];
+	bigEndian(footer, crc ^ 0xffffffffu);
+	fwrite(footer, 1, 4, file);
+}
+
+// the image data goes in stored deflate blocks. nothing is compressed, a frame costs
+// one pass over its bytes and the files stay readable by anything that reads PNG
+void writePngFrame(FILE*, const WriteJob &job, void *context)
+{
+	OffscreenTarget &target = *(OffscreenTarget*)context;
+	const unsigned int	rowLength = 1 + 3 * target.width,
+						blockLength = 65535;
+
+	// scanlines with no filter, alpha dropped
+	target.encoded.resize(rowLength * target.height);
+	unsigned int a = 1, b = 0;	// adler32 of the scanlines
+	for (unsigned int y = 0; y < target.height; y++)
+	{
+		unsigned char *out = (unsigned char*)&target.encoded[y * rowLength];
+		const unsigned char *row = (const unsigned char*)&job.data[4 * (target.height - 1 - y) * target.width];
+		*out++ = 0;
+		for (unsigned int x = 0; x < target.width; x++, row += 4)
+		{
+			*out++ = row[0];
+			*out++ = row[1];
+			*out++ = row[2];
+		}
+		updateAdler(a, b, (const unsigned char*)&target.encoded[y * rowLength], rowLength);
+	}
+
+	char filename[1024];
+	snprintf(filename, sizeof(filename), "%s_%05u.png", target.path.c_str(), job.index);
+	FILE *file = fopen(filename, "wb");
+	if (!file)
+	{
+		std::cout << "FILE " << filename << " COULD NOT BE OPENED" << std::endl;
+		return;
+	}
+
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	fwrite(signature, 1, 8, file);
+
+	unsigned int crc;
+	unsigned char header[13] = { 0 };
+	bigEndian(header, target.width);
+	bigEndian(header + 4, target.height);
+	header[8] = 8;		// bits per channel
+	header[9] = 2;		// RGB
+	beginChunk(file, crc, "IHDR", 13);
+	chunkWrite(file, crc, header, 13);
+	endChunk(file, crc);
+
+	size_t	length = target.encoded.size(),
+			blocks = (length + blockLength - 1) / blockLength;
+	beginChunk(file, crc, "IDAT", (unsigned int)(2 + 5 * blocks + length + 4));
+	static const unsigned char zlibHeader[2] = { 0x78, 0x01 };
+	chunkWrite(file, crc, zlibHeader, 2);
+	for (size_t offset = 0; offset < length; offset += blockLength)
+	{
+		unsigned int size = (unsigned int)(length - offset < blockLength ? length - offset : blockLength);
+		unsigned char block[5] = {	(unsigned char)(offset + size == length),
+									(unsigned char)size, (unsigned char)(size >> 8),
+									(unsigned char)~size, (unsigned char)(~size >> 8) };
+		chunkWrite(file, crc, block, 5);
+		chunkWrite(file, crc, &target.encoded[offset], size);
+	}
+	unsigned char adler[4];
+	bigEndian(adler, (b << 16) | a);
+	chunkWrite(file, crc, adler, 4);
+	endChunk(file, crc);
+
+	beginChunk(file, crc, "IEND", 0);
+	endChunk(file, crc);
+	fclose(file);
+}
+
+
+bool createOffscreenTarget(OffscreenTarget &target, unsigned int width, unsigned int height, int samples, int format, const std::string &path)
+{
+	target.width = width;
+	target.height = height;
+	target.format = format;
+	target.path = path;
+	target.rendered = target.collected = 0;
+
+	FILE *stream = NULL;
+	JobWriter write = writePngFrame;
+	if (format == rawFrames || format == y4mFrames)
+	{
+		std::string filename = path + (format == rawFrames ? ".rgba" : ".y4m");
+		stream = fopen(filename.c_str(), "wb");
+		if (!stream)
+		{
+			std::cout << "FILE " << filename << " COULD NOT BE OPENED" << std::endl;
+			return false;
+		}
+		if (format == y4mFrames)
+			fprintf(stream, "YUV4MPEG2 W%u H%u F60:1 Ip A1:1 C444\n", width, height);
+		write = format == rawFrames ? writeRawFrame : writeY4MFrame;
+	}
+	else
+		buildCrcTable();
+
+	glGenFramebuffers(1, &target.resolveFramebuffer);
+	glGenRenderbuffers(1, &target.resolveBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, target.resolveBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindFramebuffer(GL_FRAMEBUFFER, target.resolveFramebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.resolveBuffer);
+
+	glGenFramebuffers(1, &target.framebuffer);
+	glGenRenderbuffers(1, &target.colorBuffer);
+	glGenRenderbuffers(1, &target.depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, target.colorBuffer);
+	glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, target.depthBuffer);
+	glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height);
+	glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depthBuffer);
+
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenBuffers(offscreenReadbacks, target.pixelBuffers);
+	for (int i = 0; i < offscreenReadbacks; i++)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, target.pixelBuffers[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, 4 * width * height, NULL, GL_STREAM_READ);
+		target.fences[i] = 0;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	openWriter(target.writer, stream, write, &target, offscreenQueue);
+
+	if (!complete)
+	{
+		std::cout << "Offscreen framebuffer is incomplete" << std::endl;
+		destroyOffscreenTarget(target);
+		return false;
+	}
+	return true;
+}
+
+void beginOffscreenFrame(OffscreenTarget &target)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+	glViewport(0, 0, target.width, target.height);
+}
+
+// hands the oldest frame in flight to the writer
+void collectFrame(OffscreenTarget &target)
+{
+	unsigned int slot = target.collected % offscreenReadbacks;
+
+	// issued a couple of frames ago, this should already have passed
+	GLenum status;
+	do
+		status = glClientWaitSync(target.fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+	while (status == GL_TIMEOUT_EXPIRED);
+	glDeleteSync(target.fences[slot]);
+	target.fences[slot] = 0;
+
+	WriteJob *job = acquireJob(target.writer);
+	size_t size = 4 * target.width * target.height;
+	job->data.resize(size);
+	job->index = target.collected++;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, target.pixelBuffers[slot]);
+	const void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+	if (pixels)
+		memcpy(&job->data[0], pixels, size);
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	submitJob(target.writer, job);
+}
+
+void endOffscreenFrame(OffscreenTarget &target)
+{
+	// resolve the samples, then start the copy into a free pixel buffer and move on
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, target.framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.resolveFramebuffer);
+	glBlitFramebuffer(0, 0, target.width, target.height, 0, 0, target.width, target.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+	if (target.rendered - target.collected == offscreenReadbacks)
+		collectFrame(target);
+
+	unsigned int slot = target.rendered % offscreenReadbacks;
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, target.resolveFramebuffer);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, target.pixelBuffers[slot]);
+	glReadPixels(0, 0, target.width, target.height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	target.fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	target.rendered++;
+}
+
+// collects the frames still in flight and waits for the writer to finish them
+void destroyOffscreenTarget(OffscreenTarget &target)
+{
+	while (target.collected < target.rendered)
+		collectFrame(target);
+	closeWriter(target.writer);
+	if (target.writer.stalls)
+		std::cout << "Rendering waited on the disk " << target.writer.stalls << " times" << std::endl;
+
+	glDeleteBuffers(offscreenReadbacks, target.pixelBuffers);
+	glDeleteRenderbuffers(1, &target.colorBuffer);
+	glDeleteRenderbuffers(1, &target.depthBuffer);
+	glDeleteRenderbuffers(1, &target.resolveBuffer);
+	glDeleteFramebuffers(1, &target.framebuffer);
+	glDeleteFramebuffers(1, &target.resolveFramebuffer);
+}
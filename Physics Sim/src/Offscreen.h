@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Header.h"
+#include "AsyncWriter.h"
+#include <string>
+
+#define rawFrames			0	// RGBA bytes, top row first, back to back in one file
+#define y4mFrames			1	// 4:4:4 YUV4MPEG2 stream
+#define pngFrames			2	// one uncompressed PNG per frame
+
+#define offscreenReadbacks	3	// pixel buffers in flight, a frame is read back two frames later
+#define offscreenQueue		8	// frames waiting on the disk before rendering stalls
+
+// renders into a framebuffer instead of a window. frames are copied into pixel buffers
+// without waiting on the GPU and only mapped once their fence has passed, the encoding
+// and the disk writes happen on the writer thread
+struct OffscreenTarget
+{
+	unsigned int width, height;
+	int format;
+	std::string path;
+
+	GLuint	framebuffer,			// multisampled, rendered into
+			colorBuffer,
+			depthBuffer,
+			resolveFramebuffer,		// single sampled, read back from
+			resolveBuffer,
+			pixelBuffers[offscreenReadbacks];
+	GLsync	fences[offscreenReadbacks];
+	unsigned int rendered, collected;
+
+	std::vector<char> encoded;		// writer thread scratch
+	AsyncWriter writer;
+};
+
+bool createOffscreenContext();
+void destroyOffscreenContext();
+
+bool createOffscreenTarget(OffscreenTarget &target, unsigned int width, unsigned int height, int samples, int format, const std::string &path);
+void beginOffscreenFrame(OffscreenTarget &target);
+void endOffscreenFrame(OffscreenTarget &target);
+void destroyOffscreenTarget(OffscreenTarget &target);
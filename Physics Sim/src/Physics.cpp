@@ -1,55 +1,110 @@
 #include "Header.h"
 #include <omp.h>
-#define dampening		1.f		// this is good with a default mass of 1
-#define collisionBuffer	.01f	// to prevent clipping	
+#define collisionBuffer	.01f	// to prevent clipping
 
 using namespace glm;
 
-void springSystem(std::vector<Mass> &masses, std::vector<Spring> &springs, float planeHeight, float planeSize)
+// one kernel per combination of scene features. the flags are compile time constants
+// so every branch on them folds away and the hot loops only do the work the scene needs
+template <bool UniformStiffness, bool HasFixed, bool HasPlane>
+void springKernel(std::vector<Mass> &masses, std::vector<Spring> &springs, float planeHeight, float planeSize, float damping)
 {
+	const float dt = 1.f / stepsPerSecond;
+	// every spring shares the same constant, load it once instead of once per spring
+	const float uniformConstant = UniformStiffness && !springs.empty() ? springs[0].constant : 0.f;
+
 	// apply spring force to all masses
-	#pragma omp parallel (dynamic)
+	// springs scatter into shared masses so this loop stays serial
 	for (unsigned int i = 0; i < springs.size(); i++)
 	{
-		Spring s = springs[i];
+		const Spring &s = springs[i];
 		vec3	p1 = masses[s.m1].position,
 				p2 = masses[s.m2].position;
 
+		float constant = UniformStiffness ? uniformConstant : s.constant;
 		float length = distance(p1, p2);
-		float magnitude = -s.constant * (length - s.restLength);
-		vec3 direction = normalize(p1 - p2);
+		float magnitude = -constant * (length - s.restLength);
+		vec3 direction = (p1 - p2) / length;
 
 		vec3 force = magnitude * direction;
 
 		masses[s.m1].force += force;
-		masses[s.m2].force += -force;
+		masses[s.m2].force -= force;
 	}
 
 	// apply forces to masses
-	#pragma omp parallel (dynamic)
-	for (unsigned int i = 0; i < masses.size(); i++)
+	const int massCount = (int)masses.size();
+	#pragma omp parallel for
+	for (int i = 0; i < massCount; i++)
 	{
 		Mass *m = &masses[i];
-		if (!m->fixed)
+		if (HasFixed && m->fixed)
 		{
-			m->force.y -= gravity * m->mass;
-			// dampen the force
-			m->force += (-dampening * m->velocity);
-			// convert mass to accelleration and apply to velocity for change in time
-			m->velocity += m->force / m->mass * (1.f / stepsPerSecond);
-
-			// collision with the plane
-			// check collision height
-			if (abs(m->position.y - planeHeight) < collisionBuffer)
-				//check collision bounds
-				if (m->position.x < planeSize + collisionBuffer &&
-					m->position.x > -planeSize - collisionBuffer &&
-					m->position.z < planeSize + collisionBuffer &&
-					m->position.z > -planeSize - collisionBuffer)
-						m->velocity.y = 0;
-
-			m->position += m->velocity * (1.f / stepsPerSecond);
 			m->force = vec3(0.f, 0.f, 0.f);
+			continue;
 		}
+
+		m->force.y -= gravity * m->mass;
+		// dampen the force
+		m->force += (-damping * m->velocity);
+		// convert mass to accelleration and apply to velocity for change in time
+		m->velocity += m->force / m->mass * dt;
+
+		vec3 next = m->position + m->velocity * dt;
+
+		// collision with the plane, swept over the whole step so fast masses can not tunnel
+		// through it. evaluated without branching on the position
+		if (HasPlane)
+		{
+			float	before = m->position.y - planeHeight,
+					after = next.y - planeHeight,
+					side = before >= 0.f ? 1.f : -1.f,
+					bound = planeSize + collisionBuffer;
+			bool crosses = side * after < 0.f;
+
+			// where the step meets the plane, the bounds are checked there
+			float impact = crosses ? before / (before - after) : 0.f;
+			vec3 contact = m->position + impact * (next - m->position);
+			bool hit =	(crosses | (abs(before) < collisionBuffer)) &
+						(abs(contact.x) < bound) &
+						(abs(contact.z) < bound);
+
+			// clamp to the time of impact, just short of the plane on the side it came from
+			m->velocity.y = hit ? 0.f : m->velocity.y;
+			next.y = hit ? (crosses ? planeHeight + side * .5f * collisionBuffer : m->position.y) : next.y;
+		}
+
+		m->position = next;
+		m->force = vec3(0.f, 0.f, 0.f);
 	}
-}
\ No newline at end of file
+}
+
+// general case, handles every feature a scene may have
+void springSystem(std::vector<Mass> &masses, std::vector<Spring> &springs, float planeHeight, float planeSize, float damping)
+{
+	springKernel<false, true, true>(masses, springs, planeHeight, planeSize, damping);
+}
+
+SpringKernel selectSpringKernel(const std::vector<Mass> &masses, const std::vector<Spring> &springs, float planeSize)
+{
+	static const SpringKernel kernels[8] =
+	{
+		springKernel<false, false, false>,	springKernel<false, false, true>,
+		springKernel<false, true, false>,	springKernel<false, true, true>,
+		springKernel<true, false, false>,	springKernel<true, false, true>,
+		springKernel<true, true, false>,	springKernel<true, true, true>
+	};
+
+	bool uniformStiffness = true;
+	for (unsigned int i = 1; i < springs.size() && uniformStiffness; i++)
+		uniformStiffness = springs[i].constant == springs[0].constant;
+
+	bool hasFixed = false;
+	for (unsigned int i = 0; i < masses.size() && !hasFixed; i++)
+		hasFixed = masses[i].fixed;
+
+	// the number keys' scenes always have a plane, a scene file without a [plane] does not
+	bool hasPlane = planeSize > 0.f;
+
+	return kernels[(uniformStiffness << 2) | (hasFixed << 1) | hasPlane];
+}
@@ -0,0 +1,697 @@
+#include "Scene.h"
+#include "FileMap.h"
+#include "Import.h"
+#include <chrono>
+#include <glm/gtx/transform.hpp>
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+using namespace glm;
+
+BodyDescription defaultBody(int type)
+{
+	BodyDescription body;
+	body.type = type;
+	body.layers = ivec3(3, 3, 3);
+	body.spacing = cubeMassDistance;
+	body.reach = sqrt(3.f);			// the 26 masses around each
+	body.rise = 0.f;
+	body.mass = 1.f;
+	body.stiffness = 2000.f;
+	body.bendStiffness = 0.f;
+	body.center = vec3(0.f, 0.f, 0.f);
+	body.extent = 1.f;
+	switch (type)
+	{
+		case (chainBody):
+			body.layers = ivec3(5, 1, 1);
+			body.spacing = .7f;
+			body.reach = 1.f;
+			body.stiffness = 50.f;
+			break;
+		case (clothBody):
+			body.layers = ivec3(20, 20, 1);
+			body.spacing = .005f;
+			body.reach = 2.f;
+			body.mass = .1f;
+			break;
+		case (meshBody):
+			body.extent = meshExtent;
+			body.mass = meshMass;
+			body.stiffness = meshSpringConstant;
+			body.bendStiffness = meshBendConstant;
+			break;
+		case (tetBody):
+			body.extent = tetExtent;
+			body.mass = tetMass;
+			body.stiffness = tetSpringConstant;
+			break;
+	}
+	return body;
+}
+
+
+// centred on center and scaled to fit in extent
+void fitPositions(std::vector<vec3> &positions, vec3 center, float extent)
+{
+	vec3	lower = positions[0],
+			upper = lower;
+	for (unsigned int i = 1; i < positions.size(); i++)
+	{
+		lower = min(lower, positions[i]);
+		upper = max(upper, positions[i]);
+	}
+	vec3 middle = (lower + upper) * .5f,
+		 size = upper - lower;
+	float largest = max(size.x, max(size.y, size.z)),
+		  scale = largest > 0.f ? extent / largest : 1.f;
+
+	const int count = (int)positions.size();
+	#pragma omp parallel for
+	for (int i = 0; i < count; i++)
+		positions[i] = center + (positions[i] - middle) * scale;
+}
+
+
+// parsing
+
+// a [field]'s mesh, baked once the whole file has been read
+struct FieldSource
+{
+	unsigned int line;
+	std::string file;
+	vec3 center;
+	float extent;
+	int resolution;
+};
+
+struct SceneReader
+{
+	std::string filename;
+	unsigned int line;
+	std::string section;
+	SceneDescription *scene;
+	std::vector<FieldSource> fields;
+};
+
+bool sceneError(const SceneReader &reader, const char *problem)
+{
+	std::cout << "FILE " << reader.filename << " LINE " << reader.line << " COULD NOT BE READ, " << problem << std::endl;
+	return false;
+}
+
+// count numbers off the value, fewer there is an error. parsed like the OBJ files so a
+// scene reads the same whatever the locale
+bool readFloats(const std::string &value, float *out, int count, int *read = NULL)
+{
+	const char	*at = value.c_str(),
+				*end = at + value.size();
+	int found = 0;
+	for (; found < count; found++)
+	{
+		while (at < end && (*at == ' ' || *at == '\t'))
+			at++;
+		const char *after = parseFloat(at, end, out[found]);
+		if (!after)
+			break;
+		at = after;
+	}
+	while (at < end && (*at == ' ' || *at == '\t'))
+		at++;
+	if (read)
+		*read = found;
+	return at == end && (read ? found > 0 : found == count);
+}
+
+// as many numbers as the value has, at least one
+bool readList(const std::string &value, std::vector<float> &out)
+{
+	const char	*at = value.c_str(),
+				*end = at + value.size();
+	out.clear();
+	while (true)
+	{
+		while (at < end && (*at == ' ' || *at == '\t'))
+			at++;
+		float number;
+		const char *after = parseFloat(at, end, number);
+		if (!after)
+			break;
+		out.push_back(number);
+		at = after;
+	}
+	return at == end && !out.empty();
+}
+
+bool readVector(const std::string &value, vec3 &out)
+{
+	return readFloats(value, &out.x, 3);
+}
+
+bool readBool(const std::string &value, bool &out)
+{
+	if (value == "true" || value == "1")
+		out = true;
+	else if (value == "false" || value == "0")
+		out = false;
+	else
+		return false;
+	return true;
+}
+
+bool applyBodyKey(BodyDescription &body, const std::string &key, const std::string &value)
+{
+	float numbers[6];
+	int read;
+	if (key == "layers")
+	{
+		if (!readFloats(value, numbers, 3, &read))
+			return false;
+		body.layers = ivec3(1, 1, 1);
+		for (int i = 0; i < read; i++)
+			body.layers[i] = max((int)numbers[i], 1);
+		return true;
+	}
+	if (key == "fixed")
+	{
+		if (!readFloats(value, numbers, 6, &read) || read % 2)
+			return false;
+		FixedRange range = { ivec3(0), ivec3(INT_MAX) };
+		for (int i = 0; i < read / 2; i++)
+		{
+			range.lower[i] = (int)numbers[i];
+			range.upper[i] = (int)numbers[read / 2 + i];
+		}
+		body.fixed.push_back(range);
+		return true;
+	}
+	if (key == "center")			return readVector(value, body.center);
+	if (key == "file")
+	{
+		body.file = value;
+		return !value.empty();
+	}
+
+	float *number =	key == "spacing" ? &body.spacing :
+					key == "reach" ? &body.reach :
+					key == "rise" ? &body.rise :
+					key == "mass" ? &body.mass :
+					key == "stiffness" ? &body.stiffness :
+					key == "bendStiffness" ? &body.bendStiffness :
+					key == "extent" ? &body.extent : NULL;
+	return number && readFloats(value, number, 1);
+}
+
+bool applyColliderKey(Collider &collider, const std::string &key, const std::string &value)
+{
+	if (key == "center")			return readVector(value, collider.center);
+	if (key == "halfExtents")		return readVector(value, collider.halfExtents);
+	if (key == "a")					return readVector(value, collider.a);
+	if (key == "b")					return readVector(value, collider.b);
+	if (key == "rotation")
+	{
+		// radians about an axis
+		float numbers[4];
+		if (!readFloats(value, numbers, 4) || length(vec3(numbers[1], numbers[2], numbers[3])) == 0.f)
+			return false;
+		collider.axes = mat3(rotate(mat4(1.f), numbers[0], vec3(numbers[1], numbers[2], numbers[3])));
+		return true;
+	}
+
+	float *number =	key == "radius" ? &collider.radius :
+					key == "friction" ? &collider.friction :
+					key == "restitution" ? &collider.restitution : NULL;
+	return number && readFloats(value, number, 1);
+}
+
+bool applyKey(SceneReader &reader, const std::string &key, const std::string &value)
+{
+	SceneDescription &scene = *reader.scene;
+	const std::string &section = reader.section;
+	if (section == "plane")
+	{
+		float *number =	key == "height" ? &scene.planeHeight :
+						key == "size" ? &scene.planeSize : NULL;
+		return number && readFloats(value, number, 1);
+	}
+	if (section == "solver")
+	{
+		if (key == "selfCollision")
+			return readBool(value, scene.solver.selfCollision);
+		if (key == "meshCollision")
+			return readBool(value, scene.solver.meshCollision);
+		float *number =	key == "thickness" ? &scene.solver.thickness :
+						key == "contactDistance" ? &scene.solver.contactDistance :
+						key == "tearThreshold" ? &scene.solver.tearThreshold :
+						key == "damping" ? &scene.solver.damping : NULL;
+		return number && readFloats(value, number, 1);
+	}
+	if (section == "sweep")
+	{
+		if (key == "frames")
+		{
+			float frames;
+			if (!readFloats(value, &frames, 1) || frames < 1.f)
+				return false;
+			scene.sweepFrames = (unsigned int)frames;
+			return true;
+		}
+		if (key != "stiffness" && key != "mass" && key != "spacing" && key != "layers" && key != "damping")
+			return false;
+		SweepParameter parameter;
+		parameter.name = key;
+		scene.sweep.push_back(parameter);
+		return readList(value, scene.sweep.back().values);
+	}
+	if (section == "field")
+	{
+		FieldSource &field = reader.fields.back();
+		if (key == "file")
+		{
+			field.file = value;
+			return !value.empty();
+		}
+		if (key == "center")
+			return readVector(value, field.center);
+		if (key == "extent")
+			return readFloats(value, &field.extent, 1) && field.extent > 0.f;
+		if (key == "resolution")
+		{
+			float resolution;
+			if (!readFloats(value, &resolution, 1) || resolution < 2.f)
+				return false;
+			field.resolution = (int)resolution;
+			return true;
+		}
+		return (key == "friction" || key == "restitution") && applyColliderKey(scene.colliders.back(), key, value);
+	}
+	if (section == "sphere" || section == "box" || section == "capsule")
+		return applyColliderKey(scene.colliders.back(), key, value);
+	if (!section.empty())
+		return applyBodyKey(scene.bodies.back(), key, value);
+	return false;
+}
+
+bool openSection(SceneReader &reader, const std::string &name)
+{
+	SceneDescription &scene = *reader.scene;
+	if (name == "chain")				scene.bodies.push_back(defaultBody(chainBody));
+	else if (name == "cube")			scene.bodies.push_back(defaultBody(latticeBody));
+	else if (name == "cloth")			scene.bodies.push_back(defaultBody(clothBody));
+	else if (name == "mesh")			scene.bodies.push_back(defaultBody(meshBody));
+	else if (name == "tetrahedra")		scene.bodies.push_back(defaultBody(tetBody));
+	else if (name == "sphere")			scene.colliders.push_back(makeSphere(vec3(0.f), .1f));
+	else if (name == "box")				scene.colliders.push_back(makeBox(vec3(0.f), vec3(.1f), mat3(1.f)));
+	else if (name == "capsule")			scene.colliders.push_back(makeCapsule(vec3(-.1f, 0.f, 0.f), vec3(.1f, 0.f, 0.f), .05f));
+	else if (name == "field")
+	{
+		FieldSource field = { reader.line, std::string(), vec3(0.f), .2f, defaultFieldResolution };
+		scene.colliders.push_back(makeField((int)reader.fields.size()));
+		reader.fields.push_back(field);
+	}
+	else if (name == "plane")
+		scene.planeSize = defaultPlaneSize;
+	else if (name != "solver" && name != "sweep")
+		return false;
+	reader.section = name;
+	return true;
+}
+
+// trimmed of blanks at both ends
+std::string trimmed(const char *begin, const char *end)
+{
+	while (begin < end && (*begin == ' ' || *begin == '\t' || *begin == '\r'))
+		begin++;
+	while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+		end--;
+	return std::string(begin, end);
+}
+
+// every [field]'s mesh fitted like an imported body and sampled into a distance field
+bool bakeFields(SceneReader &reader)
+{
+	for (unsigned int i = 0; i < reader.fields.size(); i++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		const FieldSource &source = reader.fields[i];
+		reader.line = source.line;
+		if (source.file.empty())
+			return sceneError(reader, "a field needs a file");
+		ImportedMesh mesh;
+		if (!importOBJ(source.file, mesh) || mesh.triangles.empty())
+			return sceneError(reader, "the field's mesh could not be imported or has no triangles");
+
+		fitPositions(mesh.positions, source.center, source.extent);
+		reader.scene->fields.push_back(SignedDistanceField());
+		SignedDistanceField &field = reader.scene->fields.back();
+		bakeField(field, mesh.positions, mesh.triangles, source.resolution);
+		std::cout	<< "Baked " << source.file << " into a " << field.resolution.x << "x" << field.resolution.y << "x"
+					<< field.resolution.z << " distance field in "
+					<< std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s" << std::endl;
+	}
+	return true;
+}
+
+bool readSceneFile(const std::string &filename, SceneDescription &scene)
+{
+	FileMap file;
+	if (!mapFile(file, filename))
+		return false;
+
+	scene = SceneDescription();
+	scene.planeSize = 0.f;				// until a [plane] section says otherwise
+	scene.solver.meshCollision = true;
+	SceneReader reader = { filename, 0, std::string(), &scene, std::vector<FieldSource>() };
+	const char	*at = (const char*)file.data,
+				*end = at + file.size;
+	bool good = true;
+	while (good && at < end)
+	{
+		const char *lineEnd = (const char*)memchr(at, '\n', end - at);
+		if (!lineEnd)
+			lineEnd = end;
+		const char *comment = (const char*)memchr(at, '#', lineEnd - at);
+		std::string text = trimmed(at, comment ? comment : lineEnd);
+		at = lineEnd + 1;
+		reader.line++;
+
+		if (text.empty())
+			continue;
+		if (text[0] == '[')
+		{
+			if (text[text.size() - 1] != ']' || !openSection(reader, trimmed(text.c_str() + 1, text.c_str() + text.size() - 1)))
+				good = sceneError(reader, "not a section");
+			continue;
+		}
+		size_t equals = text.find('=');
+		if (equals == std::string::npos)
+		{
+			good = sceneError(reader, "not a key = value");
+			continue;
+		}
+		std::string key = trimmed(text.c_str(), text.c_str() + equals),
+					value = trimmed(text.c_str() + equals + 1, text.c_str() + text.size());
+		if (!applyKey(reader, key, value))
+			good = sceneError(reader, reader.section.empty() ? "a key outside any section" : "not a key of the section or a bad value");
+	}
+	unmapFile(file);
+	return good && bakeFields(reader);
+}
+
+
+// building
+
+// two triangles for every square of an xLayers by yLayers lattice of masses
+void appendClothTriangles(std::vector<unsigned int> &triangles, unsigned int firstMass, int xLayers, int yLayers)
+{
+	for (int xLayer = 0; xLayer < xLayers - 1; xLayer++)
+	{
+		for (int yLayer = 0; yLayer < yLayers - 1; yLayer++)
+		{
+			unsigned int	corner = firstMass + xLayer * yLayers + yLayer,
+							right = corner + yLayers,
+							up = corner + 1,
+							across = right + 1;
+			unsigned int square[6] = { corner, right, up, up, right, across };
+			triangles.insert(triangles.end(), square, square + 6);
+		}
+	}
+}
+
+// a chain, a cloth or a box of masses, springs join every pair no more than reach
+// spacings apart. only boxes are bodies of their own to the broadphase, like the cubes
+void addLatticeBody(SceneBodies &scene, const BodyDescription &body)
+{
+	const bool	chain = body.type == chainBody,
+				cloth = body.type == clothBody;
+	const ivec3 size = chain ? ivec3(1, body.layers.x, 1) : (cloth ? ivec3(body.layers.x, 1, body.layers.y) : body.layers);
+	const unsigned int firstMass = (unsigned int)scene.masses.size();
+	// a step along each axis in spacings, a risen cloth's second one climbs
+	mat3 axes(1.f);
+	if (cloth)
+		axes[2] = vec3(0.f, body.rise, 1.f);
+
+	for (int x = 0; x < size.x; x++)
+	{
+		for (int y = 0; y < size.y; y++)
+		{
+			for (int z = 0; z < size.z; z++)
+			{
+				ivec3	cell(x, y, z),
+						layer = chain ? ivec3(y, 0, 0) : (cloth ? ivec3(x, z, 0) : cell);
+				Mass m;
+				m.position = body.center + (chain ?	vec3(0.f, -y * body.spacing, 0.f) :
+													axes * (vec3(cell) - .5f * vec3(size - 1)) * body.spacing);
+				m.mass = body.mass;
+				for (unsigned int i = 0; i < body.fixed.size(); i++)
+					if (all(greaterThanEqual(layer, body.fixed[i].lower)) && all(lessThan(layer, body.fixed[i].upper)))
+						m.fixed = true;
+				scene.masses.push_back(m);
+			}
+		}
+	}
+
+	// the neighbours ahead of a mass, each pair is joined once. no step is shorter than a
+	// spacing so none further than reach layers away can be close enough
+	int window = (int)(body.reach + .001f);
+	std::vector<ivec3> offsets;
+	for (int x = 0; x <= window; x++)
+		for (int y = -window; y <= window; y++)
+			for (int z = -window; z <= window; z++)
+			{
+				vec3 step = axes * vec3(x, y, z);
+				if ((x > 0 || y > 0 || (y == 0 && z > 0)) && dot(step, step) <= body.reach * body.reach + .001f)
+					offsets.push_back(ivec3(x, y, z));
+			}
+
+	for (int x = 0; x < size.x; x++)
+	{
+		for (int y = 0; y < size.y; y++)
+		{
+			for (int z = 0; z < size.z; z++)
+			{
+				for (unsigned int i = 0; i < offsets.size(); i++)
+				{
+					ivec3 other = ivec3(x, y, z) + offsets[i];
+					if (any(lessThan(other, ivec3(0))) || any(greaterThanEqual(other, size)))
+						continue;
+					Spring s;
+					s.m1 = firstMass + (x * size.y + y) * size.z + z;
+					s.m2 = firstMass + (other.x * size.y + other.y) * size.z + other.z;
+					s.restLength = length(axes * vec3(offsets[i])) * body.spacing;
+					s.constant = body.stiffness;
+					scene.springs.push_back(s);
+				}
+			}
+		}
+	}
+
+	if (cloth)
+		appendClothTriangles(scene.triangles, firstMass, size.x, size.z);
+	if (body.type == latticeBody)
+	{
+		Body b;
+		b.firstMass = firstMass;
+		b.massCount = (unsigned int)scene.masses.size() - firstMass;
+		scene.bodies.push_back(b);
+	}
+}
+
+// a mass per imported position, the positions fitted in place
+std::vector<Mass> fitMasses(std::vector<vec3> &positions, vec3 center, float extent, float mass)
+{
+	fitPositions(positions, center, extent);
+	const int massCount = (int)positions.size();
+	std::vector<Mass> masses(massCount);
+	#pragma omp parallel for
+	for (int i = 0; i < massCount; i++)
+	{
+		masses[i].position = positions[i];
+		masses[i].mass = mass;
+	}
+	return masses;
+}
+
+// an imported body after the masses already in the scene, its indices moved past them
+void appendBody(SceneBodies &scene, std::vector<Mass> &masses, std::vector<Spring> &springs, std::vector<unsigned int> &triangles)
+{
+	const unsigned int firstMass = (unsigned int)scene.masses.size();
+	if (firstMass == 0 && scene.springs.empty() && scene.triangles.empty())
+	{
+		scene.masses.swap(masses);
+		scene.springs.swap(springs);
+		scene.triangles.swap(triangles);
+		return;
+	}
+
+	for (unsigned int i = 0; i < springs.size(); i++)
+	{
+		springs[i].m1 += firstMass;
+		springs[i].m2 += firstMass;
+	}
+	for (unsigned int i = 0; i < triangles.size(); i++)
+		triangles[i] += firstMass;
+	scene.masses.insert(scene.masses.end(), masses.begin(), masses.end());
+	scene.springs.insert(scene.springs.end(), springs.begin(), springs.end());
+	scene.triangles.insert(scene.triangles.end(), triangles.begin(), triangles.end());
+}
+
+// an OBJ as cloth, one mass per vertex
+bool addMeshBody(SceneBodies &scene, const BodyDescription &body, const ImportedMesh *imported)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	ImportedMesh mesh;
+	if (imported)
+		mesh = *imported;
+	else if (!importOBJ(body.file, mesh))
+		return false;
+	if (mesh.positions.empty())
+		return false;
+
+	std::vector<Mass> masses = fitMasses(mesh.positions, body.center, body.extent, body.mass);
+	std::vector<Spring> springs;
+	buildEdgeSprings(masses, mesh.triangles, body.stiffness, body.bendStiffness, springs);
+
+	if (!imported)
+		std::cout	<< "Imported " << body.file << ", " << masses.size() << " masses, " << mesh.triangles.size() / 3
+					<< " triangles and " << springs.size() << " springs in "
+					<< std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s" << std::endl;
+	appendBody(scene, masses, springs, mesh.triangles);
+	return true;
+}
+
+// TetGen files as a soft body, springs along the tetrahedra's edges and the masses their
+// volumes lumped onto the corners
+bool addTetBody(SceneBodies &scene, const BodyDescription &body, const ImportedTets *imported)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	ImportedTets mesh;
+	if (imported)
+		mesh = *imported;
+	else if (!importTetGen(body.file, mesh))
+		return false;
+	if (mesh.positions.empty())
+		return false;
+
+	std::vector<Mass> masses = fitMasses(mesh.positions, body.center, body.extent, body.mass);
+	lumpTetMasses(masses, mesh.tetrahedra, body.mass);
+	std::vector<Spring> springs;
+	buildTetSprings(masses, mesh.tetrahedra, body.stiffness, springs);
+
+	if (!imported)
+		std::cout	<< "Imported " << body.file << ", " << masses.size() << " masses, " << mesh.tetrahedra.size() / 4
+					<< " tetrahedra and " << springs.size() << " springs in "
+					<< std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s" << std::endl;
+
+	Body b;
+	b.firstMass = (unsigned int)scene.masses.size();
+	b.massCount = (unsigned int)masses.size();
+	scene.bodies.push_back(b);
+	std::vector<unsigned int> noTriangles;
+	appendBody(scene, masses, springs, noTriangles);
+	return true;
+}
+
+// the sheet alone, falling onto the plane
+SceneDescription clothTableScene(int layers)
+{
+	SceneDescription scene;
+	scene.planeHeight = -clothPlaneHeight;
+	scene.planeSize = clothPlaneSize;
+	scene.solver.meshCollision = true;
+	BodyDescription cloth = defaultBody(clothBody);
+	cloth.layers = ivec3(layers, layers, 1);
+	cloth.rise = 1.f;
+	cloth.reach = 2.f + 2.f * sqrt(3.f);
+	scene.bodies.push_back(cloth);
+	return scene;
+}
+
+// held up by a patch near one corner
+SceneDescription clothHangScene(int layers)
+{
+	SceneDescription scene = clothTableScene(layers);
+	FixedRange patch = { ivec3(5, 5, 0), ivec3(10, 10, INT_MAX) };
+	scene.bodies[0].fixed.push_back(patch);
+	return scene;
+}
+
+// falling over a sphere, a capsule and a box. the sheet starts level just above the sphere
+// and joins nearer masses than the table's, stiff enough to settle on it rather than jitter off
+SceneDescription clothDrapeScene(int layers)
+{
+	SceneDescription scene = clothTableScene(layers);
+	scene.bodies[0].rise = 0.f;
+	scene.bodies[0].reach = 2.5f;
+	scene.bodies[0].center = vec3(0.f, -.05f, 0.f);
+	Collider capsule = makeCapsule(vec3(-.15f, -.25f, .08f), vec3(.15f, -.25f, .08f), .015f),
+			 box = makeBox(vec3(0.f, -.35f, 0.f), vec3(.1f, .03f, .1f), mat3(rotate(identity, .3f, vec3(0.f, 1.f, 0.f))));
+	capsule.friction = .2f;
+	box.friction = .8f;
+	scene.colliders.push_back(makeSphere(vec3(0.f, -.15f, 0.f), .05f));
+	scene.colliders.push_back(capsule);
+	scene.colliders.push_back(box);
+	return scene;
+}
+
+bool importFiles(const SceneDescription &description, ImportedFiles &files)
+{
+	for (unsigned int i = 0; i < description.bodies.size(); i++)
+	{
+		const BodyDescription &body = description.bodies[i];
+		if (body.type != meshBody && body.type != tetBody)
+			continue;
+		if (body.type == meshBody ? files.meshes.count(body.file) : files.tets.count(body.file))
+			continue;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		size_t positions, elements;
+		if (body.type == meshBody)
+		{
+			ImportedMesh &mesh = files.meshes[body.file];
+			if (!importOBJ(body.file, mesh))
+				return false;
+			positions = mesh.positions.size();
+			elements = mesh.triangles.size() / 3;
+		}
+		else
+		{
+			ImportedTets &mesh = files.tets[body.file];
+			if (!importTetGen(body.file, mesh))
+				return false;
+			positions = mesh.positions.size();
+			elements = mesh.tetrahedra.size() / 4;
+		}
+		std::cout	<< "Imported " << body.file << ", " << positions << " positions and " << elements
+					<< (body.type == meshBody ? " triangles" : " tetrahedra") << " in "
+					<< std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s" << std::endl;
+	}
+	return true;
+}
+
+bool buildBodies(SceneBodies &scene, const SceneDescription &description, const ImportedFiles *files)
+{
+	for (unsigned int i = 0; i < description.bodies.size(); i++)
+	{
+		const BodyDescription &body = description.bodies[i];
+		bool added = true;
+		if (body.type == meshBody)
+		{
+			std::map<std::string, ImportedMesh>::const_iterator found;
+			bool shared = files && (found = files->meshes.find(body.file)) != files->meshes.end();
+			added = addMeshBody(scene, body, shared ? &found->second : NULL);
+		}
+		else if (body.type == tetBody)
+		{
+			std::map<std::string, ImportedTets>::const_iterator found;
+			bool shared = files && (found = files->tets.find(body.file)) != files->tets.end();
+			added = addTetBody(scene, body, shared ? &found->second : NULL);
+		}
+		else
+			addLatticeBody(scene, body);
+		if (!added)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "Header.h"
+#include "Broadphase.h"
+#include "Colliders.h"
+#include "Import.h"
+#include <map>
+#include <string>
+
+// scene files, a scene the number keys do not have without building a new binary
+//
+//	# a cloth dropped over a sphere
+//	[plane]
+//	height = -.5
+//	size = .1
+//
+//	[cloth]
+//	layers = 40 40
+//	center = 0 .1 0
+//	fixed = 5 5 10 10
+//
+//	[sphere]
+//	center = 0 -.15 0
+//	radius = .05
+//
+// a file without a [plane] has no plane, nothing stops what falls.
+// a cloth or a mesh collides with its own triangles unless the [solver] has meshCollision = false
+// or selfCollision = true, which keeps the masses apart in their place.
+// every [section] but plane, solver and sweep adds a body or a collider, its keys follow it and
+// anything left out keeps the type's default. vectors are numbers separated by spaces.
+// a chain hangs down from its center and a cloth lies level, its second axis along z.
+// rise tilts a cloth, its second axis climbing that many spacings in y for each along z.
+// fixed is a range of layers, the lower ones then the upper ones, the upper excluded.
+// there may be any number of them, an axis a range leaves out is fixed along its length
+//
+// a [field] is a collider of any shape, a closed Wavefront OBJ fitted in extent around
+// center and baked into a distance field of resolution samples along its longest side
+//
+//	[field]
+//	file = bowl.obj
+//	center = 0 -.2 0
+//	extent = .3
+//
+// a [sweep] is only for --batch, which runs the scene once for every combination of the
+// values listed. stiffness, mass, spacing and layers apply to every body, damping to the
+// solver, and frames is how long each run lasts
+//
+//	[sweep]
+//	frames = 600
+//	stiffness = 500 1000 2000
+//	damping = .5 1
+
+#define cubeMassDistance	.2f
+#define clothPlaneSize		0.1f
+#define clothPlaneHeight	0.5f
+#define defaultFieldResolution	32	// samples along a baked field's longest side
+
+#define meshExtent			.8f		// an imported mesh is scaled to fit in this
+#define meshMass			.1f
+#define meshSpringConstant	2000.f
+#define meshBendConstant	200.f
+#define tetExtent			1.f
+#define tetMass				1.f		// the mean, what the lattice cube's masses weigh
+#define tetSpringConstant	2000.f
+
+#define chainBody			0	// masses hanging one under the next
+#define latticeBody			1	// a box of masses, the cube scenes'
+#define clothBody			2	// a sheet of masses, level in x and z
+#define meshBody			3	// a Wavefront OBJ, as cloth
+#define tetBody				4	// TetGen files, as a soft body
+
+struct FixedRange
+{
+	glm::ivec3 lower, upper;
+};
+
+struct BodyDescription
+{
+	int type;
+	glm::ivec3 layers;			// masses along each of the body's axes, a chain has one and a cloth two
+	float spacing;
+	float reach;				// springs join masses this many spacings apart or closer
+	float rise;					// a cloth's tilt, spacings up per spacing along its second axis
+	float mass;					// per mass, the mean for tetrahedra
+	float stiffness;
+	float bendStiffness;		// imported meshes' bend springs
+	glm::vec3 center;
+	float extent;				// imported meshes are scaled to fit in this
+	std::string file;
+	std::vector<FixedRange> fixed;
+};
+
+struct SweepParameter
+{
+	std::string name;
+	std::vector<float> values;
+};
+
+struct SceneDescription
+{
+	SceneDescription() :	planeHeight(-defaultPlaneHeight),
+							planeSize(defaultPlaneSize),
+							sweepFrames(600) { }
+	float planeHeight, planeSize;
+	SolverSettings solver;
+	std::vector<BodyDescription> bodies;
+	std::vector<Collider> colliders;
+	std::vector<SignedDistanceField> fields;	// baked from the [field] sections, the sdf colliders' index
+	std::vector<SweepParameter> sweep;
+	unsigned int sweepFrames;
+};
+
+BodyDescription defaultBody(int type);
+
+// one pass through the mapped file. a section or key it does not know fails the whole
+// file, with the line, rather than leaving part of the scene out
+bool readSceneFile(const std::string &filename, SceneDescription &scene);
+
+// the hang, table and drape scenes of the number keys, layers across. the sheet rises one
+// spacing for each along its second axis and joins the masses two diagonals apart, but for
+// the drape's, which starts level over the sphere
+SceneDescription clothHangScene(int layers);
+SceneDescription clothTableScene(int layers);
+SceneDescription clothDrapeScene(int layers);
+
+// where a description's bodies go, the scene's own vectors or a batch run's
+struct SceneBodies
+{
+	std::vector<Mass> &masses;
+	std::vector<Spring> &springs;
+	std::vector<unsigned int> &triangles;
+	std::vector<Body> &bodies;
+};
+
+// the files a description's bodies import, read once for every build of it, by file name
+struct ImportedFiles
+{
+	std::map<std::string, ImportedMesh> meshes;
+	std::map<std::string, ImportedTets> tets;
+};
+
+bool importFiles(const SceneDescription &description, ImportedFiles &files);
+
+// imported is the body's file already read, quietly built from, or NULL to read it here
+void addLatticeBody(SceneBodies &scene, const BodyDescription &body);
+bool addMeshBody(SceneBodies &scene, const BodyDescription &body, const ImportedMesh *imported = NULL);
+bool addTetBody(SceneBodies &scene, const BodyDescription &body, const ImportedTets *imported = NULL);
+
+// every body the description has, after what the scene has already, its files taken from
+// files when given. false if one of them could not be imported
+bool buildBodies(SceneBodies &scene, const SceneDescription &description, const ImportedFiles *files = NULL);
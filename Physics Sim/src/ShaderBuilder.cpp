@@ -1,6 +1,10 @@
 #include "ShaderBuilder.h"
+#include "EmbeddedShaders.h"
 #include <iostream>
 #include <fstream>
+#include <cstring>
+#include <string>
+#include <vector>
 
 unsigned long getFileLength(std::ifstream& file)
 {
@@ -13,60 +17,74 @@ unsigned long getFileLength(std::ifstream& file)
 	return len;
 }
 
-GLchar* loadshader(std::string filename)
+// override directory, empty uses only the embedded shaders
+std::string shaderDirectory;
+
+void setShaderDirectory(const std::string &directory)
 {
-	std::ifstream file;
-	file.open(filename.c_str(), std::ios::in);
-	if (!file)
-	{
-		std::cout << "FILE " << filename.c_str() << " NOT FOUND"<< std::endl;
-		return NULL;
-	}
-	unsigned long len = getFileLength(file);
+	shaderDirectory = directory;
+}
 
-	if (len == 0) return NULL; // Error: Empty File
+// where linked program binaries go, empty links every program from source
+std::string programCacheDirectory;
 
-	GLchar* ShaderSource = 0;
+void setProgramCacheDirectory(const std::string &directory)
+{
+	programCacheDirectory = directory;
+}
 
-	ShaderSource = new char[len + 1];
+// the whole file in a single read
+bool readFile(const std::string &filename, std::string &contents)
+{
+	std::ifstream file;
+	file.open(filename.c_str(), std::ios::in | std::ios::binary);
+	unsigned long len = getFileLength(file);
+	if (len == 0) return false;
 
-	if (ShaderSource == 0) return NULL;
+	contents.resize(len);
+	file.read(&contents[0], len);
+	return (unsigned long)file.gcount() == len;
+}
 
-	ShaderSource[len] = 0;
+// a file in the override directory wins over the embedded copy
+bool loadshader(const char* name, std::string &source)
+{
+	if (!shaderDirectory.empty() && readFile(shaderDirectory + "/" + name, source))
+		return true;
 
-	unsigned int i = 0;
-	while (file.good())
+	for (int i = 0; i < embeddedShaderCount; i++)
 	{
-		ShaderSource[i] = file.get();
-		if (!file.eof())
-			i++;
+		if (strcmp(embeddedShaders[i].name, name) == 0)
+		{
+			source = embeddedShaders[i].source;
+			return true;
+		}
 	}
 
-	ShaderSource[i] = 0;
-
-	file.close();
-
-	return ShaderSource;
+	std::cout << "SHADER " << name << " NOT FOUND" << std::endl;
+	return false;
 }
 
-void unloadshader(GLchar** ShaderSource)
+// compiled but not checked, asking would wait for the compiler. the shader is kept until
+// the build is finished so its log can still be read then
+GLuint attachShader(GLuint &program, const GLchar* source, GLuint shaderType)
 {
-	if (*ShaderSource != 0)delete[] * ShaderSource;
-	*ShaderSource = 0;
-}
+	if (!source)
+		return 0;
 
-void attachShader(GLuint &program, const char* fileName, GLuint shaderType)
-{
 	GLuint shader;
-	const GLchar *shaderSource[] = { loadshader(fileName) };
+	const GLchar *shaderSource[] = { source };
 
-	// Create and compile the vertex shader
 	shader = glCreateShader(shaderType);
 	glShaderSource(shader, 1, shaderSource, NULL);
 	glCompileShader(shader);
-	GLint status;
+	glAttachShader(program, shader);
+	return shader;
+}
 
-	// Check for compilation errors
+void checkShader(GLuint shader, const std::string &fileName)
+{
+	GLint status;
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
 	if (status == GL_FALSE)
 	{
@@ -81,40 +99,248 @@ void attachShader(GLuint &program, const char* fileName, GLuint shaderType)
 		fprintf(stderr, "Compilation error in shader vertex_shader: \n%s", strInfoLog);
 		delete[] strInfoLog;
 	}
+}
 
-	glAttachShader(program, shader);
 
-	glDeleteShader(shader);
-	unloadshader((GLchar**)shaderSource);
+// program binary cache
+// a binary only loads on the driver that wrote it and only matches the sources it was
+// linked from, so both go into the name of its file. anything stale simply misses
+
+unsigned long long hashString(unsigned long long hash, const char* str)
+{
+	// 64 bit FNV-1a
+	for (; str && *str; str++)
+	{
+		hash ^= (unsigned char)*str;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+std::string programCacheName(const GLchar* sources[], const GLenum types[], int count)
+{
+	unsigned long long hash = 14695981039346656037ull;
+	hash = hashString(hash, (const char*)glGetString(GL_VENDOR));
+	hash = hashString(hash, (const char*)glGetString(GL_RENDERER));
+	hash = hashString(hash, (const char*)glGetString(GL_VERSION));
+	for (int i = 0; i < count; i++)
+	{
+		hash = (hash ^ types[i]) * 1099511628211ull;
+		hash = hashString(hash, sources[i]);
+	}
+
+	char name[32];
+	snprintf(name, sizeof(name), "/cache-%016llx.bin", hash);
+	return programCacheDirectory + name;
+}
+
+bool programBinariesSupported()
+{
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+// the file holds the binary format followed by the binary
+bool loadProgramBinary(GLuint program, const std::string &cacheName)
+{
+	std::string binary;
+	if (!readFile(cacheName, binary) || binary.size() <= sizeof(GLenum)) return false;
+
+	GLenum format;
+	memcpy(&format, &binary[0], sizeof(GLenum));
+	glProgramBinary(program, format, &binary[sizeof(GLenum)], (GLsizei)(binary.size() - sizeof(GLenum)));
+
+	GLint status;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	return status == GL_TRUE;
+}
+
+void saveProgramBinary(GLuint program, const std::string &cacheName)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	std::vector<char> binary(sizeof(GLenum) + length);
+	GLenum format;
+	glGetProgramBinary(program, length, NULL, &format, &binary[sizeof(GLenum)]);
+	memcpy(&binary[0], &format, sizeof(GLenum));
+
+	// the cache is only an optimisation, the program is fine without the file
+	std::ofstream file;
+	file.open(cacheName.c_str(), std::ios::out | std::ios::binary);
+	if (!file || !file.write(&binary[0], binary.size()))
+		std::cout << "FILE " << cacheName << " COULD NOT BE WRITTEN, the program is linked again next time" << std::endl;
+}
+
+// KHR_parallel_shader_compile, or the ARB extension it came from. the driver then compiles
+// and links on threads of its own and says when it is done without waiting for it
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+int parallelCompile = -1;	// not looked up yet
+
+bool parallelCompileSupported()
+{
+	if (parallelCompile < 0)
+	{
+		parallelCompile = 0;
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count && !parallelCompile; i++)
+		{
+			const char *name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			parallelCompile = name && (	strcmp(name, "GL_KHR_parallel_shader_compile") == 0 ||
+										strcmp(name, "GL_ARB_parallel_shader_compile") == 0);
+		}
+	}
+	return parallelCompile == 1;
+}
+
+void startBuild(ProgramBuild &build, const char* filenames[], const GLenum types[], int count)
+{
+	std::string loaded[5];
+	const GLchar* sources[5];
+	bool cacheable = !programCacheDirectory.empty() && programBinariesSupported();
+	for (int i = 0; i < count; i++)
+	{
+		bool found = loadshader(filenames[i], loaded[i]);
+		sources[i] = found ? loaded[i].c_str() : NULL;
+		cacheable = cacheable && found;
+	}
+
+	build.count = 0;
+	build.cacheName.clear();
+	build.cached = false;
+	build.program = glCreateProgram();
+	if (cacheable)
+	{
+		std::string cacheName = programCacheName(sources, types, count);
+		build.cached = loadProgramBinary(build.program, cacheName);
+		if (build.cached)
+			return;
+
+		// a failed load leaves the program unusable, start again from a fresh one
+		glDeleteProgram(build.program);
+		build.program = glCreateProgram();
+		build.cacheName = cacheName;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		GLuint shader = attachShader(build.program, sources[i], types[i]);
+		if (!shader)
+			continue;
+		build.shaders[build.count] = shader;
+		build.filenames[build.count++] = filenames[i];
+	}
+	if (cacheable)
+		glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(build.program);
+}
+
+void startProgram(ProgramBuild &build, const char* vertexFilename, const char* geometryFilename, const char* fragmentFilename)
+{
+	const char* filenames[3];
+	GLenum types[3];
+	int count = 0;
+	filenames[count] = vertexFilename;
+	types[count++] = GL_VERTEX_SHADER;
+	if (geometryFilename)
+	{
+		filenames[count] = geometryFilename;
+		types[count++] = GL_GEOMETRY_SHADER;
+	}
+	filenames[count] = fragmentFilename;
+	types[count++] = GL_FRAGMENT_SHADER;
+	startBuild(build, filenames, types, count);
+}
+
+bool programBuilt(const ProgramBuild &build)
+{
+	if (build.cached || !parallelCompileSupported())
+		return true;
+
+	GLint done;
+	glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &done);
+	return done == GL_TRUE;
+}
+
+void releaseShaders(ProgramBuild &build)
+{
+	for (int i = 0; i < build.count; i++)
+	{
+		glDetachShader(build.program, build.shaders[i]);
+		glDeleteShader(build.shaders[i]);
+	}
+	build.count = 0;
+}
+
+bool finishProgram(ProgramBuild &build)
+{
+	if (build.cached)
+		return true;
+
+	GLint status;
+	glGetProgramiv(build.program, GL_LINK_STATUS, &status);
+	if (status == GL_FALSE)
+	{
+		for (int i = 0; i < build.count; i++)
+			checkShader(build.shaders[i], build.filenames[i]);
+
+		GLint infoLogLength;
+		glGetProgramiv(build.program, GL_INFO_LOG_LENGTH, &infoLogLength);
+
+		GLchar* strInfoLog = new GLchar[infoLogLength + 1];
+		glGetProgramInfoLog(build.program, infoLogLength, NULL, strInfoLog);
+
+		std::cout << "\n\n" << (build.count ? build.filenames[0] : "") << std::endl; // show which program has the error
+
+		fprintf(stderr, "Link error in program: \n%s", strInfoLog);
+		delete[] strInfoLog;
+	}
+	else if (!build.cacheName.empty())
+		saveProgramBinary(build.program, build.cacheName);
+
+	releaseShaders(build);
+	return status == GL_TRUE;
+}
+
+void discardProgram(ProgramBuild &build)
+{
+	releaseShaders(build);
+	glDeleteProgram(build.program);
+	build.program = 0;
+}
+
+// at startup there is nothing to draw with until it is linked, so it is waited for
+GLuint buildProgram(const char* filenames[], const GLenum types[], int count)
+{
+	ProgramBuild build;
+	startBuild(build, filenames, types, count);
+	finishProgram(build);
+	return build.program;
 }
 
 GLuint generateProgram(const char* vertexFilename, const char* fragmentFilename)
 {
-	GLuint program = glCreateProgram();
-	attachShader(program, vertexFilename, GL_VERTEX_SHADER);
-	attachShader(program, fragmentFilename, GL_FRAGMENT_SHADER);
-	glLinkProgram(program);
-	return program;
+	const char* filenames[] = { vertexFilename, fragmentFilename };
+	const GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+	return buildProgram(filenames, types, 2);
 }
 
 GLuint generateProgram(const char* vertexFilename, const char* geometryFilename, const char* fragmentFilename)
 {
-	GLuint program = glCreateProgram();
-	attachShader(program, vertexFilename, GL_VERTEX_SHADER);
-	attachShader(program, geometryFilename, GL_GEOMETRY_SHADER);
-	attachShader(program, fragmentFilename, GL_FRAGMENT_SHADER);
-	glLinkProgram(program);
-	return program;
+	const char* filenames[] = { vertexFilename, geometryFilename, fragmentFilename };
+	const GLenum types[] = { GL_VERTEX_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER };
+	return buildProgram(filenames, types, 3);
 }
 
 GLuint generateProgram(const char* vertexFilename, const char* geometryFilename, const char* tessContFilename, const char* tessEvalFilename, const char* fragmentFilename)
 {
-	GLuint program = glCreateProgram();
-	attachShader(program, vertexFilename, GL_VERTEX_SHADER);
-	attachShader(program, geometryFilename, GL_GEOMETRY_SHADER);
-	attachShader(program, tessContFilename, GL_TESS_CONTROL_SHADER);
-	attachShader(program, tessEvalFilename, GL_TESS_EVALUATION_SHADER);
-	attachShader(program, fragmentFilename, GL_FRAGMENT_SHADER);
-	glLinkProgram(program);
-	return program;
+	const char* filenames[] = { vertexFilename, geometryFilename, tessContFilename, tessEvalFilename, fragmentFilename };
+	const GLenum types[] = { GL_VERTEX_SHADER, GL_GEOMETRY_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER, GL_FRAGMENT_SHADER };
+	return buildProgram(filenames, types, 5);
 }
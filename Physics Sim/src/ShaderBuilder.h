@@ -1,7 +1,39 @@
 #pragma once
 
 #include <glad\glad.h>
+#include <string>
+
+// shaders are found by name, in the override directory first and then among the
+// sources compiled into the program
+void setShaderDirectory(const std::string &directory);
+
+// linked programs are kept as binaries in this directory and loaded instead of linking
+// when the driver and sources match. nothing is cached until it is set
+void setProgramCacheDirectory(const std::string &directory);
 
 GLuint generateProgram(const char* vertexFilename, const char* fragmentFilename);
 GLuint generateProgram(const char* vertexFilename, const char* geometryFilename, const char* fragmentFilename);
-GLuint generateProgram(const char* vertexFilename, const char* geometryFilename, const char* tessContFilename, const char* tessEvalFilename, const char* fragmentFilename);
\ No newline at end of file
+GLuint generateProgram(const char* vertexFilename, const char* geometryFilename, const char* tessContFilename, const char* tessEvalFilename, const char* fragmentFilename);
+
+// a program built while frames go on, to reload one without stalling them. where the driver
+// has KHR_parallel_shader_compile it compiles and links on its own threads and programBuilt
+// says whether it is done without waiting. without the extension it is always done and
+// finishProgram waits for the link
+struct ProgramBuild
+{
+	GLuint program;
+	GLuint shaders[5];				// attached until the build is finished, for their logs
+	std::string filenames[5];
+	int count;
+	std::string cacheName;			// where the binary goes once linked, empty when not cached
+	bool cached;					// loaded from the cache, already linked
+};
+
+// geometryFilename may be NULL
+void startProgram(ProgramBuild &build, const char* vertexFilename, const char* geometryFilename, const char* fragmentFilename);
+bool programBuilt(const ProgramBuild &build);
+// reports what failed or caches the binary, true if the program linked. the program is the
+// caller's either way
+bool finishProgram(ProgramBuild &build);
+// a build that is no longer wanted, finished or not
+void discardProgram(ProgramBuild &build);
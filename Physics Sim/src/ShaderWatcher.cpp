@@ -0,0 +1,120 @@
+#include "ShaderWatcher.h"
+#include <chrono>
+#include <iostream>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#define watchInterval	250		// ms between checks for the thread to stop, or polls of the files
+
+void markChanged(ShaderWatcher &watcher, const std::string &name)
+{
+	for (unsigned int i = 0; i < watcher.names.size(); i++)
+	{
+		if (watcher.names[i] == name)
+		{
+			std::lock_guard<std::mutex> lock(watcher.mutex);
+			watcher.changed.insert(name);
+			return;
+		}
+	}
+}
+
+long long modificationTime(const std::string &path)
+{
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 ? (long long)info.st_mtime : 0;
+}
+
+#ifdef __linux__
+// editors either rewrite the file in place or write a new one and rename it over the old
+void watchLoop(ShaderWatcher *watcher)
+{
+	char events[4096];
+	pollfd descriptor = { watcher->descriptor, POLLIN, 0 };
+	while (watcher->running)
+	{
+		if (poll(&descriptor, 1, watchInterval) <= 0)
+			continue;
+
+		ssize_t length = read(watcher->descriptor, events, sizeof(events));
+		for (ssize_t offset = 0; offset < length;)
+		{
+			const inotify_event *event = (const inotify_event*)(events + offset);
+			if (event->len > 0)
+				markChanged(*watcher, event->name);
+			offset += sizeof(inotify_event) + event->len;
+		}
+	}
+}
+#else
+// second resolution modification times, enough for a file saved by hand
+void watchLoop(ShaderWatcher *watcher)
+{
+	while (watcher->running)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(watchInterval));
+		for (unsigned int i = 0; i < watcher->names.size(); i++)
+		{
+			long long time = modificationTime(watcher->directory + "/" + watcher->names[i]);
+			if (time != watcher->modified[i])
+			{
+				watcher->modified[i] = time;
+				markChanged(*watcher, watcher->names[i]);
+			}
+		}
+	}
+}
+#endif
+
+bool startShaderWatcher(ShaderWatcher &watcher, const std::string &directory, const std::vector<std::string> &names)
+{
+	watcher.directory = directory;
+	watcher.names = names;
+	watcher.modified.resize(names.size());
+	for (unsigned int i = 0; i < names.size(); i++)
+		watcher.modified[i] = modificationTime(directory + "/" + names[i]);
+
+#ifdef __linux__
+	watcher.descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watcher.descriptor < 0 ||
+		inotify_add_watch(watcher.descriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		std::cout << "Could not watch " << directory << " for shader changes" << std::endl;
+		if (watcher.descriptor >= 0)
+			close(watcher.descriptor);
+		watcher.descriptor = -1;
+		return false;
+	}
+#endif
+
+	watcher.running = true;
+	watcher.thread = std::thread(watchLoop, &watcher);
+	return true;
+}
+
+// the files changed since the last call, each named once however often it was saved
+void takeChangedShaders(ShaderWatcher &watcher, std::vector<std::string> &changed)
+{
+	changed.clear();
+	std::lock_guard<std::mutex> lock(watcher.mutex);
+	changed.assign(watcher.changed.begin(), watcher.changed.end());
+	watcher.changed.clear();
+}
+
+void stopShaderWatcher(ShaderWatcher &watcher)
+{
+	if (!watcher.thread.joinable())
+		return;
+	watcher.running = false;
+	watcher.thread.join();
+
+#ifdef __linux__
+	close(watcher.descriptor);
+	watcher.descriptor = -1;
+#endif
+}
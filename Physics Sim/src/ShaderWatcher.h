@@ -0,0 +1,28 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// watches the shader override directory on its own thread, the render loop only picks up
+// the names of the files that changed. inotify on Linux, modification times elsewhere
+struct ShaderWatcher
+{
+	ShaderWatcher() :	running(false),
+						descriptor(-1) { }
+	std::string directory;
+	std::vector<std::string> names;		// only these files are reported
+	std::vector<long long> modified;	// last seen modification times, when polling
+	std::set<std::string> changed;
+	std::mutex mutex;
+	std::thread thread;
+	std::atomic<bool> running;
+	int descriptor;						// inotify instance
+};
+
+bool startShaderWatcher(ShaderWatcher &watcher, const std::string &directory, const std::vector<std::string> &names);
+void takeChangedShaders(ShaderWatcher &watcher, std::vector<std::string> &changed);
+void stopShaderWatcher(ShaderWatcher &watcher);
@@ -0,0 +1,149 @@
+#include "SharedState.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(SharedStateHeader) == 64, "readers rely on the header layout");
+
+#ifdef _WIN32
+// a pagefile backed mapping, gone once the last process closes it
+void *createSegment(SharedState &shared)
+{
+	HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+		(DWORD)((unsigned long long)shared.size >> 32), (DWORD)shared.size, shared.segment.c_str());
+	if (mapping && GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		// a reader still holds a segment by this name, it may be too small for us
+		CloseHandle(mapping);
+		mapping = NULL;
+	}
+	void *data = mapping ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, shared.size) : NULL;
+	if (!data && mapping)
+		CloseHandle(mapping);
+	shared.mapping = mapping;
+	return data;
+}
+
+void destroySegment(SharedState &shared)
+{
+	UnmapViewOfFile(shared.header);
+	CloseHandle((HANDLE)shared.mapping);
+}
+#else
+// a stale segment from a run that crashed is replaced, the name lives until closed
+void *createSegment(SharedState &shared)
+{
+	shm_unlink(shared.segment.c_str());
+	int descriptor = shm_open(shared.segment.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (descriptor < 0)
+		return NULL;
+	void *data = ftruncate(descriptor, (off_t)shared.size) == 0 ?
+		mmap(NULL, shared.size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0) : MAP_FAILED;
+	close(descriptor);
+	if (data == MAP_FAILED)
+	{
+		shm_unlink(shared.segment.c_str());
+		return NULL;
+	}
+	return data;
+}
+
+void destroySegment(SharedState &shared)
+{
+	munmap(shared.header, shared.size);
+	shm_unlink(shared.segment.c_str());
+}
+#endif
+
+bool openGeneration(SharedState &shared, const std::string &name, unsigned int capacity, unsigned int generation)
+{
+	shared.name = name;
+	shared.generation = generation;
+	shared.segment = generation ? name + "." + std::to_string(generation) : name;
+	shared.size = sizeof(SharedStateHeader) + 2 * 3 * sizeof(float) * (size_t)capacity;
+	void *data = createSegment(shared);
+	if (!data)
+	{
+		std::cout << "Could not create the shared memory segment " << shared.segment << std::endl;
+		shared = SharedState();
+		return false;
+	}
+
+	// fresh pages are zeroed, only the header needs filling in
+	shared.header = new (data) SharedStateHeader;
+	shared.header->sequence.store(0, std::memory_order_relaxed);
+	shared.header->magic = sharedStateMagic;
+	shared.header->version = sharedStateVersion;
+	shared.header->retired = 0;
+	shared.header->capacity = capacity;
+	shared.header->massCount = 0;
+	shared.header->frame = 0;
+	shared.header->generation = generation;
+	shared.header->positions = sizeof(SharedStateHeader);
+	shared.header->velocities = sizeof(SharedStateHeader) + 3 * sizeof(float) * (size_t)capacity;
+	std::atomic_thread_fence(std::memory_order_release);
+	return true;
+}
+
+bool openSharedState(SharedState &shared, const std::string &name, unsigned int capacity)
+{
+	return openGeneration(shared, name, capacity, 0);
+}
+
+// the one copy on the way out, straight from the masses into the segment
+void publishState(SharedState &shared, const std::vector<Mass> &masses, unsigned int frame)
+{
+	if (!shared.header)
+		return;
+
+	SharedStateHeader *header = shared.header;
+	const int massCount = (int)masses.size();
+	if ((unsigned int)massCount > header->capacity)
+	{
+		// the old arrays stay readable, readers just learn to look for the next generation
+		unsigned int	capacity = header->capacity,
+						generation = shared.generation + 1;
+		header->retired = 1;
+		header->sequence.fetch_add(2, std::memory_order_release);
+		std::string name = shared.name;
+		closeSharedState(shared);
+		if (!openGeneration(shared, name, std::max((unsigned int)massCount, 2 * capacity), generation))
+			return;
+		header = shared.header;
+	}
+
+	unsigned int sequence = header->sequence.load(std::memory_order_relaxed);
+	header->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	float	*positions = (float*)((char*)header + header->positions),
+			*velocities = (float*)((char*)header + header->velocities);
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < massCount; i++)
+	{
+		memcpy(positions + 3 * i, &masses[i].position, 3 * sizeof(float));
+		memcpy(velocities + 3 * i, &masses[i].velocity, 3 * sizeof(float));
+	}
+	header->massCount = massCount;
+	header->frame = frame;
+
+	header->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void closeSharedState(SharedState &shared)
+{
+	if (shared.header)
+		destroySegment(shared);
+	shared = SharedState();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Header.h"
+#include <atomic>
+#include <string>
+
+// the positions and velocities of every mass, published into a named shared memory segment
+// after each frame for other processes on the machine to map read only
+//
+//	SharedStateHeader, 64 bytes
+//	capacity * 3 floats, positions x y z
+//	capacity * 3 floats, velocities x y z
+//
+// the header's sequence is a seqlock. it is odd while the simulation writes, so a reader
+//	1. loads sequence, tries again later if it is odd
+//	2. copies what it needs of massCount, frame and the arrays
+//	3. loads sequence again, the copy is whole only if it did not change
+// a reader never blocks the simulation. a scene too big for the segment retires it and
+// creates a bigger one as the next generation, name.1 after name, name.2 after that. a
+// reader seeing retired set maps the name with the header's generation plus one. a fresh
+// name each time means a reader still holding the old one can not keep it from being made
+
+#define sharedStateMagic		0x53535350u		// "PSSS"
+#define sharedStateVersion		2
+
+struct SharedStateHeader
+{
+	std::atomic<unsigned int> sequence;
+	unsigned int magic, version;
+	unsigned int retired;
+	unsigned int capacity;						// masses the arrays have room for
+	unsigned int massCount, frame;				// written under the sequence like the arrays
+	unsigned int generation;					// 0 for the name as given
+	unsigned long long positions, velocities;	// byte offsets of the arrays from the header
+	unsigned int reserved[4];
+};
+
+struct SharedState
+{
+	SharedState() :	generation(0),
+					header(NULL),
+					size(0),
+					mapping(NULL) { }
+	std::string name;			// as given, generation 0's
+	unsigned int generation;
+	std::string segment;		// the name this generation goes by
+	SharedStateHeader *header;
+	size_t size;
+	void *mapping;				// platform handle
+};
+
+bool openSharedState(SharedState &shared, const std::string &name, unsigned int capacity);
+void publishState(SharedState &shared, const std::vector<Mass> &masses, unsigned int frame);
+void closeSharedState(SharedState &shared);
@@ -0,0 +1,479 @@
+#include "StreamServer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+
+#define pollSockets		WSAPoll
+#define closeSocket		closesocket
+#define invalidSocket	((StreamSocket)INVALID_SOCKET)
+#define sendFlags		0
+
+bool setNonBlocking(StreamSocket socket)
+{
+	u_long on = 1;
+	return ioctlsocket((SOCKET)socket, FIONBIO, &on) == 0;
+}
+bool wouldBlock()		{ return WSAGetLastError() == WSAEWOULDBLOCK; }
+bool startSockets()		{ WSADATA data; return WSAStartup(MAKEWORD(2, 2), &data) == 0; }
+void stopSockets()		{ WSACleanup(); }
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define pollSockets		poll
+#define closeSocket		close
+#define invalidSocket	((StreamSocket)-1)
+#ifdef MSG_NOSIGNAL
+#define sendFlags		MSG_NOSIGNAL	// a viewer hanging up is an error, not a signal
+#else
+#define sendFlags		0
+#endif
+
+bool setNonBlocking(StreamSocket socket)
+{
+	return fcntl((int)socket, F_SETFL, fcntl((int)socket, F_GETFL) | O_NONBLOCK) == 0;
+}
+bool wouldBlock()		{ return errno == EAGAIN || errno == EWOULDBLOCK; }
+bool startSockets()		{ return true; }
+void stopSockets()		{ }
+#endif
+
+using namespace glm;
+
+bool isPort(const std::string &address)
+{
+	if (address.empty())
+		return false;
+	for (unsigned int i = 0; i < address.size(); i++)
+		if (address[i] < '0' || address[i] > '9')
+			return false;
+	return true;
+}
+
+// listening or connected, invalidSocket when it could not be
+StreamSocket openSocket(const std::string &address, bool listening)
+{
+	StreamSocket s = invalidSocket;
+	bool bound;
+	if (isPort(address))
+	{
+		sockaddr_in local;
+		memset(&local, 0, sizeof(local));
+		local.sin_family = AF_INET;
+		local.sin_port = htons((unsigned short)atoi(address.c_str()));
+		local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);		// this machine's viewers only
+
+		s = (StreamSocket)socket(AF_INET, SOCK_STREAM, 0);
+		if (s == invalidSocket)
+			return invalidSocket;
+		int on = 1;
+		if (listening)
+			setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+		setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+		bound = listening ?	bind(s, (sockaddr*)&local, sizeof(local)) == 0 && listen(s, SOMAXCONN) == 0 :
+							connect(s, (sockaddr*)&local, sizeof(local)) == 0;
+	}
+	else
+	{
+#ifdef _WIN32
+		std::cout << "Streaming over a socket path is not supported here, give a port" << std::endl;
+		return invalidSocket;
+#else
+		sockaddr_un local;
+		memset(&local, 0, sizeof(local));
+		local.sun_family = AF_UNIX;
+		if (address.size() >= sizeof(local.sun_path))
+			return invalidSocket;
+		strcpy(local.sun_path, address.c_str());
+
+		s = (StreamSocket)socket(AF_UNIX, SOCK_STREAM, 0);
+		if (s == invalidSocket)
+			return invalidSocket;
+		if (listening)
+			unlink(address.c_str());
+		bound = listening ?	bind(s, (sockaddr*)&local, sizeof(local)) == 0 && listen(s, SOMAXCONN) == 0 :
+							connect(s, (sockaddr*)&local, sizeof(local)) == 0;
+#endif
+	}
+
+	if (!bound)
+	{
+		closeSocket(s);
+		return invalidSocket;
+	}
+	return s;
+}
+
+
+// server thread
+
+StreamBuffer packFrame(StreamServer &server, TrajectoryFrame frame, const std::vector<unsigned short> *previous)
+{
+	encodeFrame(server.current, previous, server.encoded);
+	frame.keyframe = previous == NULL;
+	frame.size = (unsigned int)server.encoded.size();
+
+	std::shared_ptr<std::vector<unsigned char> > buffer = std::make_shared<std::vector<unsigned char> >(sizeof(frame) + frame.size);
+	memcpy(buffer->data(), &frame, sizeof(frame));
+	memcpy(buffer->data() + sizeof(frame), server.encoded.data(), frame.size);
+	return buffer;
+}
+
+// each encoding is made once however many clients it goes to, a keyframe only when a
+// client needs one
+void queueFrame(StreamServer &server, const StreamFrame &source)
+{
+	TrajectoryFrame frame;
+	quantizeFrame(source.positions.data(), (unsigned int)source.positions.size(), frame, server.current);
+	frame.frame = source.index;
+
+	bool deltas =	source.index % trajectoryKeyframes != 0 &&
+					server.previousIndex == (long long)source.index - 1 &&
+					server.previous.size() == server.current.size();
+	StreamBuffer delta, keyframe;
+	for (unsigned int c = 0; c < server.clients.size(); c++)
+	{
+		StreamClient &client = server.clients[c];
+		if (client.queue.size() >= streamQueue)
+		{
+			client.dropped++;
+			server.clientDrops++;
+			client.next = -1;
+			continue;
+		}
+
+		bool useDelta = deltas && client.next == (long long)source.index;
+		StreamBuffer &buffer = useDelta ? delta : keyframe;
+		if (!buffer)
+			buffer = packFrame(server, frame, useDelta ? &server.previous : NULL);
+		client.queue.push_back(buffer);
+		client.next = (long long)source.index + 1;
+	}
+
+	server.previous.swap(server.current);
+	server.previousIndex = source.index;
+}
+
+// as much of the queue as the socket takes without blocking, false once the client is gone
+bool sendQueued(StreamServer &server, StreamClient &client)
+{
+	while (!client.queue.empty())
+	{
+		const std::vector<unsigned char> &buffer = *client.queue.front();
+		long long written = send(client.socket, (const char*)buffer.data() + client.sent, (int)(buffer.size() - client.sent), sendFlags);
+		if (written < 0)
+			return wouldBlock();
+		server.bytesSent += written;
+		client.sent += (size_t)written;
+		if (client.sent < buffer.size())
+			return true;
+		client.queue.pop_front();
+		client.sent = 0;
+	}
+	return true;
+}
+
+void serveStream(StreamServer *server)
+{
+	std::vector<pollfd> descriptors;
+	std::vector<StreamFrame*> taken;
+	StreamBuffer header;
+	while (server->running)
+	{
+		StreamBuffer latest;
+		unsigned int scene;
+		{
+			std::lock_guard<std::mutex> lock(server->mutex);
+			latest = server->header;
+			scene = server->scene;
+			taken.assign(server->queue.begin(), server->queue.end());
+			server->queue.clear();
+		}
+
+		// a new scene starts every client over with its header and a keyframe
+		if (scene != server->sentScene)
+		{
+			header = latest;
+			server->sentScene = scene;
+			server->previousIndex = -1;
+			for (unsigned int c = 0; c < server->clients.size(); c++)
+			{
+				server->clients[c].queue.push_back(header);
+				server->clients[c].next = -1;
+			}
+		}
+		for (unsigned int i = 0; i < taken.size(); i++)
+			if (taken[i]->scene == scene)
+				queueFrame(*server, *taken[i]);
+		{
+			std::lock_guard<std::mutex> lock(server->mutex);
+			server->freeFrames.insert(server->freeFrames.end(), taken.begin(), taken.end());
+		}
+
+		descriptors.clear();
+		pollfd listener = { (decltype(pollfd().fd))server->listener, POLLIN, 0 };
+		descriptors.push_back(listener);
+		for (unsigned int c = 0; c < server->clients.size(); c++)
+		{
+			pollfd client = {	(decltype(pollfd().fd))server->clients[c].socket,
+								(short)(server->clients[c].queue.empty() ? POLLIN : POLLIN | POLLOUT), 0 };
+			descriptors.push_back(client);
+		}
+		pollSockets(descriptors.data(), (unsigned int)descriptors.size(), streamPoll);
+
+		// viewers send nothing, reading only notices them hanging up
+		for (int c = (int)server->clients.size() - 1; c >= 0; c--)
+		{
+			StreamClient &client = server->clients[c];
+			short events = descriptors[c + 1].revents;
+			bool closed = (events & (POLLERR | POLLHUP | POLLNVAL)) != 0;
+			if (!closed && (events & POLLIN))
+			{
+				char scratch[256];
+				long long received = recv(client.socket, scratch, sizeof(scratch), 0);
+				closed = received == 0 || (received < 0 && !wouldBlock());
+			}
+			if (!closed && (events & POLLOUT))
+				closed = !sendQueued(*server, client);
+			if (closed)
+			{
+				closeSocket(client.socket);
+				server->clients.erase(server->clients.begin() + c);
+			}
+		}
+
+		if (descriptors[0].revents & POLLIN)
+		{
+			StreamSocket socket;
+			while ((socket = (StreamSocket)accept(server->listener, NULL, NULL)) != invalidSocket)
+			{
+				setNonBlocking(socket);
+				StreamClient client;
+				client.socket = socket;
+				client.sent = 0;
+				client.next = -1;
+				client.dropped = 0;
+				if (header)
+					client.queue.push_back(header);
+				server->clients.push_back(client);
+			}
+		}
+		server->clientCount = (unsigned int)server->clients.size();
+	}
+}
+
+
+bool startStreamServer(StreamServer &server, const std::string &address)
+{
+	if (!startSockets())
+		return false;
+	server.listener = openSocket(address, true);
+	if (server.listener == invalidSocket || !setNonBlocking(server.listener))
+	{
+		std::cout << "Could not stream on " << address << std::endl;
+		if (server.listener != invalidSocket)
+			closeSocket(server.listener);
+		server.listener = invalidSocket;
+		stopSockets();
+		return false;
+	}
+	server.path = isPort(address) ? "" : address;
+
+	server.pool.resize(streamFrames);
+	server.freeFrames.clear();
+	for (unsigned int i = 0; i < server.pool.size(); i++)
+		server.freeFrames.push_back(&server.pool[i]);
+	server.previousIndex = -1;
+	server.sentScene = server.scene;
+	server.bytesSent = 0;
+	server.clientDrops = 0;
+
+	server.running = true;
+	server.thread = std::thread(serveStream, &server);
+	std::cout << "Streaming on " << address << std::endl;
+	return true;
+}
+
+void streamScene(StreamServer &server, const std::vector<Mass> &masses, const std::vector<Spring> &springs,
+				 const std::vector<unsigned int> &triangles)
+{
+	if (!server.running)
+		return;
+	std::shared_ptr<std::vector<unsigned char> > header = std::make_shared<std::vector<unsigned char> >();
+	packTrajectoryHeader(masses, springs, triangles, *header);
+
+	std::lock_guard<std::mutex> lock(server.mutex);
+	server.header = header;
+	server.massCount = (unsigned int)masses.size();
+	server.scene++;
+	server.frames = 0;
+}
+
+// never waits, with the pool empty the server thread is behind and the frame is skipped
+void streamFrame(StreamServer &server, const std::vector<Mass> &masses)
+{
+	if (!server.running || masses.size() != server.massCount)
+		return;
+
+	// numbered whether anyone watches or not, frames then count from the scene's start
+	StreamFrame *frame = NULL;
+	unsigned int index, scene;
+	{
+		std::lock_guard<std::mutex> lock(server.mutex);
+		index = server.frames++;
+		scene = server.scene;
+		if (server.clientCount == 0)
+			return;
+		if (!server.freeFrames.empty())
+		{
+			frame = server.freeFrames.back();
+			server.freeFrames.pop_back();
+		}
+		else
+			server.poolDrops++;
+	}
+	if (!frame)
+		return;
+
+	const int massCount = (int)masses.size();
+	frame->positions.resize(massCount);
+	#pragma omp parallel for
+	for (int i = 0; i < massCount; i++)
+		frame->positions[i] = masses[i].position;
+	frame->index = index;
+	frame->scene = scene;
+
+	std::lock_guard<std::mutex> lock(server.mutex);
+	server.queue.push_back(frame);
+}
+
+void stopStreamServer(StreamServer &server)
+{
+	if (!server.running)
+		return;
+	server.running = false;
+	server.thread.join();
+
+	for (unsigned int c = 0; c < server.clients.size(); c++)
+		closeSocket(server.clients[c].socket);
+	server.clients.clear();
+	server.clientCount = 0;
+	closeSocket(server.listener);
+	server.listener = invalidSocket;
+#ifndef _WIN32
+	if (!server.path.empty())
+		unlink(server.path.c_str());
+#endif
+	stopSockets();
+
+	std::cout	<< "Streamed " << server.bytesSent / 1024 << " KB, dropped " << server.clientDrops
+				<< " frames for slow viewers and " << server.poolDrops << " while the server was busy" << std::endl;
+}
+
+
+// stand in viewer
+
+bool runStreamClient(const std::string &address, const std::string &filename, unsigned int delay)
+{
+	if (!startSockets())
+		return false;
+	StreamSocket socket = openSocket(address, false);
+	if (socket == invalidSocket)
+	{
+		std::cout << "Could not connect to " << address << std::endl;
+		stopSockets();
+		return false;
+	}
+	FILE *stream = NULL;
+	if (!filename.empty() && !(stream = fopen(filename.c_str(), "wb")))
+		std::cout << "FILE " << filename << " COULD NOT BE OPENED" << std::endl;
+
+	std::vector<unsigned char> pending;
+	size_t consumed = 0;
+	char buffer[16384];
+	unsigned int scenes = 0, frames = 0, keyframes = 0, missed = 0;
+	unsigned long long received = 0;
+	long long last = -1;
+	long long length;
+	while ((length = recv(socket, buffer, sizeof(buffer), 0)) > 0)
+	{
+		received += length;
+		pending.insert(pending.end(), buffer, buffer + length);
+
+		// whole messages, a header starts with the magic and a frame with its index
+		for (;;)
+		{
+			const unsigned char *at = pending.data() + consumed;
+			size_t available = pending.size() - consumed, size;
+			unsigned int magic = 0;
+			if (available >= sizeof(magic))
+				memcpy(&magic, at, sizeof(magic));
+			if (magic == trajectoryMagic && available >= sizeof(TrajectoryHeader))
+			{
+				TrajectoryHeader header;
+				memcpy(&header, at, sizeof(header));
+				size = sizeof(header) + (2ull * header.springCount + 3ull * header.triangleCount) * sizeof(unsigned int);
+				if (available < size)
+					break;
+				if (++scenes > 1 && stream)
+				{
+					std::cout << "The scene changed, saving stopped" << std::endl;
+					fclose(stream);
+					stream = NULL;
+				}
+				std::cout << "Scene of " << header.massCount << " masses" << std::endl;
+				last = -1;
+			}
+			else if (magic != trajectoryMagic && available >= sizeof(TrajectoryFrame))
+			{
+				TrajectoryFrame frame;
+				memcpy(&frame, at, sizeof(frame));
+				size = sizeof(frame) + frame.size;
+				if (available < size)
+					break;
+				frames++;
+				keyframes += frame.keyframe;
+				if (last >= 0 && frame.frame > last + 1)
+					missed += (unsigned int)(frame.frame - last - 1);
+				last = frame.frame;
+			}
+			else
+				break;
+
+			if (stream)
+				fwrite(at, 1, size, stream);
+			consumed += size;
+		}
+		if (consumed > sizeof(buffer))
+		{
+			pending.erase(pending.begin(), pending.begin() + consumed);
+			consumed = 0;
+		}
+
+		if (delay)
+			std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+	}
+
+	closeSocket(socket);
+	stopSockets();
+	if (stream)
+		fclose(stream);
+	std::cout	<< "Received " << frames << " frames, " << keyframes << " keyframes, " << missed << " dropped, "
+				<< (frames ? received / frames : 0) << " bytes a frame" << std::endl;
+	return true;
+}
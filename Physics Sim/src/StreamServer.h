@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Header.h"
+#include "Trajectory.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// streams positions to viewers in other processes, over a Unix socket or a TCP port on
+// localhost. an address of only digits is a port, anything else a socket path
+//
+// a client gets the trajectory format as a byte stream: a TrajectoryHeader with its spring
+// and triangle indices whenever the scene changes, then a TrajectoryFrame and payload per
+// frame. saved as it arrives it plays back with --play
+//
+// the simulation only copies positions into a pooled frame, the server thread encodes
+// and sends. every client has a bounded queue, a client that falls behind loses frames
+// and gets a keyframe when it catches up, the simulation never waits on a client
+
+#define streamFrames		4		// pooled frames between the simulation and the server thread
+#define streamQueue			4		// frames a client may be behind before its frames are dropped
+#define streamPoll			4		// ms the server thread waits on the sockets
+
+typedef long long StreamSocket;		// a SOCKET on Windows, a descriptor elsewhere
+typedef std::shared_ptr<const std::vector<unsigned char> > StreamBuffer;	// encoded once, sent to many
+
+struct StreamFrame
+{
+	std::vector<glm::vec3> positions;
+	unsigned int index, scene;
+};
+
+struct StreamClient
+{
+	StreamSocket socket;
+	std::deque<StreamBuffer> queue;
+	size_t sent;					// bytes of the queue's front already written
+	long long next;					// frame a delta may be sent for, otherwise a keyframe goes next
+	unsigned int dropped;
+};
+
+struct StreamServer
+{
+	StreamServer() :	listener(-1),
+						running(false),
+						clientCount(0),
+						scene(0),
+						massCount(0),
+						frames(0),
+						poolDrops(0) { }
+	StreamSocket listener;
+	std::string path;				// unix socket to remove on stop
+	std::atomic<bool> running;
+	std::atomic<unsigned int> clientCount;
+	std::thread thread;
+
+	// shared with the simulation
+	std::mutex mutex;
+	std::vector<StreamFrame> pool;
+	std::vector<StreamFrame*> freeFrames;
+	std::deque<StreamFrame*> queue;
+	StreamBuffer header;			// the current scene's
+	unsigned int scene, massCount, frames;
+	unsigned int poolDrops;			// frames the server thread was too busy to take
+
+	// server thread only
+	std::vector<StreamClient> clients;
+	std::vector<unsigned short> previous, current;
+	std::vector<unsigned char> encoded;
+	long long previousIndex;
+	unsigned int sentScene;
+	unsigned long long bytesSent;
+	unsigned int clientDrops;
+};
+
+bool startStreamServer(StreamServer &server, const std::string &address);
+void streamScene(StreamServer &server, const std::vector<Mass> &masses, const std::vector<Spring> &springs,
+				 const std::vector<unsigned int> &triangles);
+void streamFrame(StreamServer &server, const std::vector<Mass> &masses);
+void stopStreamServer(StreamServer &server);
+
+// a stand in viewer, counts what arrives and saves the first scene to filename if given.
+// delay is ms slept after every read, to play a slow viewer
+bool runStreamClient(const std::string &address, const std::string &filename, unsigned int delay);
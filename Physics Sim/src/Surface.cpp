@@ -0,0 +1,46 @@
+#include "Surface.h"
+
+using namespace glm;
+
+void buildSurface(SurfaceNormals &surface, const TriangleMesh &mesh, unsigned int massCount)
+{
+	surface.triangleStart.assign(massCount + 1, 0);
+	for (unsigned int i = 0; i < mesh.triangles.size(); i++)
+		surface.triangleStart[mesh.triangles[i] + 1]++;
+	for (unsigned int i = 0; i < massCount; i++)
+		surface.triangleStart[i + 1] += surface.triangleStart[i];
+
+	surface.vertexTriangles.resize(mesh.triangles.size());
+	std::vector<unsigned int> fill(surface.triangleStart.begin(), surface.triangleStart.end() - 1);
+	for (unsigned int i = 0; i < mesh.triangles.size(); i++)
+		surface.vertexTriangles[fill[mesh.triangles[i]]++] = i / 3;
+
+	surface.faceNormals.resize(mesh.triangles.size() / 3);
+	surface.normals.assign(massCount, vec3(0.f));
+}
+
+void computeNormals(SurfaceNormals &surface, const TriangleMesh &mesh, const std::vector<Mass> &masses)
+{
+	// the cross product is twice the area, larger triangles weigh more on their vertices
+	const int triangleCount = (int)surface.faceNormals.size();
+	#pragma omp parallel for
+	for (int t = 0; t < triangleCount; t++)
+	{
+		const unsigned int *v = &mesh.triangles[3 * t];
+		vec3	a = masses[v[0]].position,
+				b = masses[v[1]].position,
+				c = masses[v[2]].position;
+		surface.faceNormals[t] = cross(b - a, c - a);
+	}
+
+	const int massCount = (int)surface.normals.size();
+	#pragma omp parallel for
+	for (int i = 0; i < massCount; i++)
+	{
+		vec3 sum(0.f);
+		for (unsigned int j = surface.triangleStart[i]; j < surface.triangleStart[i + 1]; j++)
+			sum += surface.faceNormals[surface.vertexTriangles[j]];
+		float length2 = dot(sum, sum);
+		surface.normals[i] = length2 > 0.f ? sum / sqrt(length2) : sum;
+	}
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Header.h"
+#include "BVH.h"
+
+// per vertex normals of a triangle mesh for shading. the triangles around every vertex are
+// listed once per scene, so each frame is two passes without any writes to shared data:
+// one normal per triangle, then one sum per vertex
+struct SurfaceNormals
+{
+	std::vector<unsigned int>	triangleStart,		// per mass offsets into vertexTriangles
+								vertexTriangles;	// triangles around each mass
+	std::vector<glm::vec3>		faceNormals,		// area weighted
+								normals;			// one per mass, zero off the mesh
+};
+
+void buildSurface(SurfaceNormals &surface, const TriangleMesh &mesh, unsigned int massCount);
+void computeNormals(SurfaceNormals &surface, const TriangleMesh &mesh, const std::vector<Mass> &masses);
@@ -0,0 +1,91 @@
+#include "Topology.h"
+#include <omp.h>
+
+using namespace glm;
+
+void buildTopology(SpringTopology &topology, unsigned int massCount, const std::vector<Spring> &springs)
+{
+	topology.rowStart.assign(massCount + 1, 0);
+	topology.rowCount.assign(massCount, 0);
+	topology.incident.resize(2 * springs.size());
+	topology.slots.resize(2 * springs.size());
+	topology.dirty.clear();
+
+	for (unsigned int i = 0; i < springs.size(); i++)
+	{
+		topology.rowStart[springs[i].m1 + 1]++;
+		topology.rowStart[springs[i].m2 + 1]++;
+	}
+	for (unsigned int i = 0; i < massCount; i++)
+		topology.rowStart[i + 1] += topology.rowStart[i];
+
+	for (unsigned int i = 0; i < springs.size(); i++)
+	{
+		unsigned int	m1 = springs[i].m1,
+						m2 = springs[i].m2,
+						slot1 = topology.rowStart[m1] + topology.rowCount[m1]++,
+						slot2 = topology.rowStart[m2] + topology.rowCount[m2]++;
+		topology.incident[slot1] = topology.incident[slot2] = i;
+		topology.slots[2 * i] = slot1;
+		topology.slots[2 * i + 1] = slot2;
+	}
+}
+
+// take one slot out of a mass's row by moving the row's last entry into it
+void removeSlot(SpringTopology &topology, const std::vector<Spring> &springs, unsigned int mass, unsigned int slot)
+{
+	unsigned int	last = topology.rowStart[mass] + --topology.rowCount[mass],
+					moved = topology.incident[last];
+	topology.incident[slot] = moved;
+	topology.slots[2 * moved + (springs[moved].m1 == mass ? 0 : 1)] = slot;
+}
+
+void removeSpring(SpringTopology &topology, std::vector<Spring> &springs, unsigned int spring)
+{
+	const Spring &s = springs[spring];
+	removeSlot(topology, springs, s.m1, topology.slots[2 * spring]);
+	removeSlot(topology, springs, s.m2, topology.slots[2 * spring + 1]);
+
+	// swap and pop, then point the rows of the spring that moved at its new index
+	unsigned int last = (unsigned int)springs.size() - 1;
+	if (spring != last)
+	{
+		springs[spring] = springs[last];
+		topology.slots[2 * spring] = topology.slots[2 * last];
+		topology.slots[2 * spring + 1] = topology.slots[2 * last + 1];
+		topology.incident[topology.slots[2 * spring]] = spring;
+		topology.incident[topology.slots[2 * spring + 1]] = spring;
+		topology.dirty.push_back(spring);
+	}
+	springs.pop_back();
+	topology.slots.resize(2 * springs.size());
+}
+
+unsigned int tearSprings(SpringTopology &topology, const std::vector<Mass> &masses, std::vector<Spring> &springs, float threshold)
+{
+	const int springCount = (int)springs.size();
+	topology.tornPerThread.resize(omp_get_max_threads());
+	for (unsigned int t = 0; t < topology.tornPerThread.size(); t++)
+		topology.tornPerThread[t].clear();
+
+	// static schedule hands out ascending blocks, so the joined list is sorted
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < springCount; i++)
+	{
+		const Spring &s = springs[i];
+		vec3 delta = masses[s.m1].position - masses[s.m2].position;
+		float limit = threshold * s.restLength;
+		if (dot(delta, delta) > limit * limit)
+			topology.tornPerThread[omp_get_thread_num()].push_back(i);
+	}
+
+	topology.torn.clear();
+	for (unsigned int t = 0; t < topology.tornPerThread.size(); t++)
+		topology.torn.insert(topology.torn.end(), topology.tornPerThread[t].begin(), topology.tornPerThread[t].end());
+
+	// highest index first, the spring swapped in from the back is then never still waiting to go
+	for (int i = (int)topology.torn.size() - 1; i >= 0; i--)
+		removeSpring(topology, springs, topology.torn[i]);
+
+	return (unsigned int)topology.torn.size();
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Header.h"
+
+// springs touching each mass, kept beside springVec so a spring can be removed in O(1)
+// rows are sized when the scene is built and only ever shrink, so nothing shifts on removal
+struct SpringTopology
+{
+	std::vector<unsigned int>	rowStart,		// first slot of every mass
+								rowCount,		// live springs in every row
+								incident,		// spring indices, row by row
+								slots,			// where spring s sits in the rows of m1 and m2
+								dirty,			// springs whose masses changed since the last upload
+								torn;			// scratch for tearSprings
+	std::vector<std::vector<unsigned int> > tornPerThread;
+};
+
+void buildTopology(SpringTopology &topology, unsigned int massCount, const std::vector<Spring> &springs);
+void removeSpring(SpringTopology &topology, std::vector<Spring> &springs, unsigned int spring);
+unsigned int tearSprings(SpringTopology &topology, const std::vector<Mass> &masses, std::vector<Spring> &springs, float threshold);
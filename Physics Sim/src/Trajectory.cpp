@@ -0,0 +1,342 @@
+#include "Trajectory.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+
+using namespace glm;
+
+void writeBytes(TrajectoryRecorder &recorder, const void *data, size_t size)
+{
+	if (size > 0)
+		fwrite(data, 1, size, recorder.writer.stream);
+	recorder.offset += size;
+}
+
+void putVarint(std::vector<unsigned char> &out, unsigned int value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((unsigned char)value);
+}
+
+void quantizeFrame(const vec3 *positions, unsigned int count, TrajectoryFrame &frame, std::vector<unsigned short> &quantized)
+{
+	vec3	lower(FLT_MAX),
+			upper(-FLT_MAX);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		lower = min(lower, positions[i]);
+		upper = max(upper, positions[i]);
+	}
+	vec3 extent = upper - lower;
+	vec3 scale(	extent.x > 0.f ? 65535.f / extent.x : 0.f,
+				extent.y > 0.f ? 65535.f / extent.y : 0.f,
+				extent.z > 0.f ? 65535.f / extent.z : 0.f);
+
+	quantized.resize(3 * count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		vec3 q = (positions[i] - lower) * scale + .5f;
+		for (int axis = 0; axis < 3; axis++)
+			quantized[3 * i + axis] = (unsigned short)min(q[axis], 65535.f);
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		frame.lower[axis] = lower[axis];
+		frame.upper[axis] = upper[axis];
+	}
+}
+
+void encodeFrame(const std::vector<unsigned short> &current, const std::vector<unsigned short> *previous, std::vector<unsigned char> &encoded)
+{
+	encoded.clear();
+	if (!previous)
+	{
+		const unsigned char *raw = (const unsigned char*)current.data();
+		encoded.assign(raw, raw + current.size() * sizeof(unsigned short));
+		return;
+	}
+
+	// wrapping 16 bit differences, small ones either way zigzag into small varints
+	for (unsigned int k = 0; k < current.size(); k++)
+	{
+		short delta = (short)(current[k] - (*previous)[k]);
+		putVarint(encoded, (unsigned short)((delta << 1) ^ (delta >> 15)));
+	}
+}
+
+// runs on the writer thread, the job holds the frame's positions as they were simulated
+void writeTrajectoryFrame(FILE*, const WriteJob &job, void *context)
+{
+	TrajectoryRecorder &recorder = *(TrajectoryRecorder*)context;
+	TrajectoryFrame frame;
+	quantizeFrame((const vec3*)job.data.data(), recorder.massCount, frame, recorder.current);
+
+	bool keyframe = job.index % trajectoryKeyframes == 0;
+	if (keyframe)
+	{
+		TrajectoryKeyframe entry = { job.index, 0, recorder.offset };
+		recorder.keyframes.push_back(entry);
+	}
+	encodeFrame(recorder.current, keyframe ? NULL : &recorder.previous, recorder.encoded);
+
+	frame.frame = job.index;
+	frame.keyframe = keyframe;
+	frame.size = (unsigned int)recorder.encoded.size();
+	writeBytes(recorder, &frame, sizeof(frame));
+	writeBytes(recorder, recorder.encoded.data(), recorder.encoded.size());
+	recorder.previous.swap(recorder.current);
+}
+
+void packTrajectoryHeader(const std::vector<Mass> &masses, const std::vector<Spring> &springs,
+						  const std::vector<unsigned int> &triangles, std::vector<unsigned char> &out)
+{
+	TrajectoryHeader header = {	trajectoryMagic, trajectoryVersion,
+								(unsigned int)masses.size(), (unsigned int)springs.size(), (unsigned int)triangles.size() / 3,
+								trajectoryKeyframes };
+	out.resize(sizeof(header) + (2 * springs.size() + triangles.size()) * sizeof(unsigned int));
+	memcpy(out.data(), &header, sizeof(header));
+	unsigned int *indices = (unsigned int*)(out.data() + sizeof(header));
+	for (unsigned int i = 0; i < springs.size(); i++)
+	{
+		indices[2 * i] = springs[i].m1;
+		indices[2 * i + 1] = springs[i].m2;
+	}
+	if (!triangles.empty())
+		memcpy(indices + 2 * springs.size(), triangles.data(), triangles.size() * sizeof(unsigned int));
+}
+
+bool startRecording(TrajectoryRecorder &recorder, const std::string &filename, const std::vector<Mass> &masses,
+					const std::vector<Spring> &springs, const std::vector<unsigned int> &triangles)
+{
+	FILE *stream = fopen(filename.c_str(), "wb");
+	if (!stream)
+	{
+		std::cout << "FILE " << filename << " COULD NOT BE OPENED" << std::endl;
+		return false;
+	}
+
+	recorder.massCount = (unsigned int)masses.size();
+	recorder.frames = 0;
+	recorder.offset = 0;
+	recorder.keyframes.clear();
+	recorder.writer.stream = stream;
+
+	// what to draw the positions with, springs as they were when recording started
+	std::vector<unsigned char> header;
+	packTrajectoryHeader(masses, springs, triangles, header);
+	writeBytes(recorder, header.data(), header.size());
+
+	openWriter(recorder.writer, stream, writeTrajectoryFrame, &recorder, trajectoryQueue);
+	recorder.recording = true;
+	return true;
+}
+
+void recordFrame(TrajectoryRecorder &recorder, const std::vector<Mass> &masses)
+{
+	if (!recorder.recording)
+		return;
+	if (masses.size() != recorder.massCount)
+	{
+		std::cout << "The scene changed, recording stopped" << std::endl;
+		stopRecording(recorder);
+		return;
+	}
+
+	WriteJob *job = acquireJob(recorder.writer);
+	job->data.resize(recorder.massCount * sizeof(vec3));
+	vec3 *positions = (vec3*)job->data.data();
+
+	const int massCount = (int)recorder.massCount;
+	#pragma omp parallel for
+	for (int i = 0; i < massCount; i++)
+		positions[i] = masses[i].position;
+
+	job->index = recorder.frames++;
+	submitJob(recorder.writer, job);
+}
+
+// the keyframe index goes at the end, once every frame is on disk
+void stopRecording(TrajectoryRecorder &recorder)
+{
+	if (!recorder.recording)
+		return;
+	recorder.recording = false;
+
+	stopWriter(recorder.writer);
+	TrajectoryFooter footer = {	recorder.offset, (unsigned int)recorder.keyframes.size(), recorder.frames,
+								trajectoryMagic, 0 };
+	writeBytes(recorder, recorder.keyframes.data(), recorder.keyframes.size() * sizeof(TrajectoryKeyframe));
+	writeBytes(recorder, &footer, sizeof(footer));
+	closeWriter(recorder.writer);
+
+	if (recorder.writer.stalls)
+		std::cout << "Recording waited on the disk " << recorder.writer.stalls << " times" << std::endl;
+}
+
+
+// playback
+
+// decodes the frame at offset on top of the last one, false if the file ends inside it
+bool decodeFrame(TrajectoryPlayer &player, unsigned long long offset)
+{
+	const unsigned int count = player.header.massCount;
+	if (offset + sizeof(TrajectoryFrame) > player.framesEnd)
+		return false;
+	TrajectoryFrame frame;
+	memcpy(&frame, player.file.data + offset, sizeof(frame));
+	const unsigned char	*payload = player.file.data + offset + sizeof(frame),
+						*end = payload + frame.size;
+	if (offset + sizeof(frame) + frame.size > player.framesEnd)
+		return false;
+
+	if (frame.keyframe)
+	{
+		if (frame.size != 3 * count * sizeof(unsigned short))
+			return false;
+		memcpy(player.quantized.data(), payload, frame.size);
+	}
+	else
+	{
+		// a delta frame only follows the frame before it
+		if (player.frame < 0 || frame.frame != (unsigned int)player.frame + 1)
+			return false;
+		for (unsigned int k = 0; k < 3 * count; k++)
+		{
+			unsigned int value = 0;
+			for (int shift = 0; payload < end; shift += 7)
+			{
+				unsigned char byte = *payload++;
+				value |= (unsigned int)(byte & 0x7f) << shift;
+				if (byte < 0x80)
+					break;
+			}
+			unsigned short delta = (unsigned short)((value >> 1) ^ (0u - (value & 1)));
+			player.quantized[k] = (unsigned short)(player.quantized[k] + delta);
+		}
+	}
+
+	vec3	lower(frame.lower[0], frame.lower[1], frame.lower[2]),
+			step = (vec3(frame.upper[0], frame.upper[1], frame.upper[2]) - lower) / 65535.f;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const unsigned short *q = &player.quantized[3 * i];
+		player.positions[i] = lower + vec3(q[0], q[1], q[2]) * step;
+	}
+
+	player.frame = (int)frame.frame;
+	player.next = offset + sizeof(frame) + frame.size;
+	return true;
+}
+
+bool openTrajectory(TrajectoryPlayer &player, const std::string &filename)
+{
+	if (!mapFile(player.file, filename))
+		return false;
+
+	const FileMap &file = player.file;
+	if (file.size < sizeof(TrajectoryHeader))
+	{
+		std::cout << "FILE " << filename << " IS NOT A TRAJECTORY" << std::endl;
+		closeTrajectory(player);
+		return false;
+	}
+	memcpy(&player.header, file.data, sizeof(TrajectoryHeader));
+	const TrajectoryHeader &header = player.header;
+	unsigned long long firstFrame = sizeof(TrajectoryHeader) +
+		(2ull * header.springCount + 3ull * header.triangleCount) * sizeof(unsigned int);
+	if (header.magic != trajectoryMagic || header.version != trajectoryVersion || firstFrame > file.size)
+	{
+		std::cout << "FILE " << filename << " IS NOT A TRAJECTORY" << std::endl;
+		closeTrajectory(player);
+		return false;
+	}
+	player.springs = (const unsigned int*)(file.data + sizeof(TrajectoryHeader));
+	player.triangles = player.springs + 2 * header.springCount;
+
+	TrajectoryFooter footer;
+	memcpy(&footer, file.data + file.size - sizeof(footer), sizeof(footer));
+	bool indexed =	file.size >= firstFrame + sizeof(footer) &&
+					footer.magic == trajectoryMagic &&
+					footer.indexOffset + footer.keyframeCount * sizeof(TrajectoryKeyframe) + sizeof(footer) == file.size;
+	if (indexed)
+	{
+		player.keyframes.resize(footer.keyframeCount);
+		if (footer.keyframeCount)
+			memcpy(player.keyframes.data(), file.data + footer.indexOffset, footer.keyframeCount * sizeof(TrajectoryKeyframe));
+		player.frameCount = footer.frameCount;
+		player.framesEnd = footer.indexOffset;
+	}
+	else
+	{
+		// the recording never finished, find its keyframes by walking the frames once
+		std::cout << "Trajectory has no index, scanning it" << std::endl;
+		player.keyframes.clear();
+		player.frameCount = 0;
+		unsigned long long offset = firstFrame;
+		TrajectoryFrame frame;
+		while (offset + sizeof(frame) <= file.size)
+		{
+			memcpy(&frame, file.data + offset, sizeof(frame));
+			if (offset + sizeof(frame) + frame.size > file.size)
+				break;
+			if (frame.keyframe)
+			{
+				TrajectoryKeyframe entry = { frame.frame, 0, offset };
+				player.keyframes.push_back(entry);
+			}
+			player.frameCount = frame.frame + 1;
+			offset += sizeof(frame) + frame.size;
+		}
+		player.framesEnd = offset;
+	}
+
+	player.frame = -1;
+	player.quantized.assign(3 * header.massCount, 0);
+	player.positions.assign(header.massCount, vec3(0.f));
+	if (player.keyframes.empty() || !seekTrajectory(player, 0))
+	{
+		std::cout << "FILE " << filename << " HOLDS NO FRAMES" << std::endl;
+		closeTrajectory(player);
+		return false;
+	}
+	return true;
+}
+
+bool seekTrajectory(TrajectoryPlayer &player, unsigned int frame)
+{
+	if (frame >= player.frameCount)
+		frame = player.frameCount - 1;
+	if (player.frame == (int)frame)
+		return true;
+
+	// last keyframe at or before the target, restart there unless the target is just ahead
+	std::vector<TrajectoryKeyframe>::const_iterator keyframe = std::upper_bound(player.keyframes.begin(), player.keyframes.end(), frame,
+		[](unsigned int f, const TrajectoryKeyframe &k) { return f < k.frame; });
+	if (keyframe == player.keyframes.begin())
+		return false;
+	--keyframe;
+	if (player.frame < 0 || (int)frame < player.frame || (int)keyframe->frame > player.frame)
+	{
+		if (!decodeFrame(player, keyframe->offset))
+			return false;
+	}
+
+	while (player.frame < (int)frame)
+	{
+		if (!decodeFrame(player, player.next))
+			return false;
+	}
+	return true;
+}
+
+void closeTrajectory(TrajectoryPlayer &player)
+{
+	unmapFile(player.file);
+	player.keyframes.clear();
+	player.frame = -1;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Header.h"
+#include "AsyncWriter.h"
+#include "FileMap.h"
+#include <string>
+
+// trajectory files, little endian
+//
+//	TrajectoryHeader
+//	springCount * 2 mass indices, triangleCount * 3 mass indices
+//	per frame, TrajectoryFrame then its payload
+//	keyframeCount * TrajectoryKeyframe, the index
+//	TrajectoryFooter
+//
+// positions are quantized to 16 bits per axis inside the frame's bounds. a keyframe stores
+// the quantized values as they are, every other frame stores each value's difference from
+// the previous frame zigzag varint coded, one byte for most masses on most axes. the
+// differences are taken between integers, so nothing drifts however long the run
+
+#define trajectoryMagic			0x52545350u		// "PSTR"
+#define trajectoryVersion		1
+#define trajectoryKeyframes		120				// frames between keyframes, two seconds
+#define trajectoryQueue			8				// frames waiting on the disk before the simulation stalls
+
+struct TrajectoryHeader
+{
+	unsigned int magic, version;
+	unsigned int massCount, springCount, triangleCount;
+	unsigned int keyframeInterval;
+};
+
+struct TrajectoryFrame
+{
+	unsigned int frame;
+	unsigned int keyframe;
+	unsigned int size;			// payload bytes after this
+	float lower[3], upper[3];	// bounds the positions are quantized in
+};
+
+struct TrajectoryKeyframe
+{
+	unsigned int frame, padding;
+	unsigned long long offset;	// of its TrajectoryFrame
+};
+
+struct TrajectoryFooter
+{
+	unsigned long long indexOffset;
+	unsigned int keyframeCount, frameCount;
+	unsigned int magic, padding;
+};
+
+// main thread copies the positions, the writer thread does everything else
+struct TrajectoryRecorder
+{
+	TrajectoryRecorder() :	recording(false) { }
+	bool recording;
+	unsigned int massCount, frames;
+
+	// writer thread only
+	std::vector<unsigned short> previous, current;
+	std::vector<unsigned char> encoded;
+	std::vector<TrajectoryKeyframe> keyframes;
+	unsigned long long offset;
+
+	AsyncWriter writer;
+};
+
+// the encoding, shared with anything else sending frames in this format. a NULL previous
+// encodes a keyframe
+void packTrajectoryHeader(const std::vector<Mass> &masses, const std::vector<Spring> &springs,
+						  const std::vector<unsigned int> &triangles, std::vector<unsigned char> &out);
+void quantizeFrame(const glm::vec3 *positions, unsigned int count, TrajectoryFrame &frame, std::vector<unsigned short> &quantized);
+void encodeFrame(const std::vector<unsigned short> &current, const std::vector<unsigned short> *previous, std::vector<unsigned char> &encoded);
+
+bool startRecording(TrajectoryRecorder &recorder, const std::string &filename, const std::vector<Mass> &masses,
+					const std::vector<Spring> &springs, const std::vector<unsigned int> &triangles);
+void recordFrame(TrajectoryRecorder &recorder, const std::vector<Mass> &masses);
+void stopRecording(TrajectoryRecorder &recorder);
+
+// plays a file back straight from its mapping. a seek decodes forward from the nearest
+// keyframe at or before the target, so it costs at most one keyframe interval of frames
+// however long the recording is
+struct TrajectoryPlayer
+{
+	TrajectoryPlayer() :	frameCount(0),
+							frame(-1) { }
+	FileMap file;
+	TrajectoryHeader header;
+	const unsigned int *springs, *triangles;	// into the mapping
+	std::vector<TrajectoryKeyframe> keyframes;
+	unsigned int frameCount;
+	unsigned long long framesEnd;				// where the frames stop and the index starts
+
+	// the decoded frame
+	int frame;									// -1 before the first decode
+	unsigned long long next;					// offset of the frame after it
+	std::vector<unsigned short> quantized;
+	std::vector<glm::vec3> positions;
+};
+
+bool openTrajectory(TrajectoryPlayer &player, const std::string &filename);
+bool seekTrajectory(TrajectoryPlayer &player, unsigned int frame);
+void closeTrajectory(TrajectoryPlayer &player);
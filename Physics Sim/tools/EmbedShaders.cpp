@@ -0,0 +1,96 @@
+// writes EmbeddedShaders.h from the shader sources, run by the build before anything
+// compiles so the program always carries what is in shaders/
+//
+//	EmbedShaders <header> <shader>...
+//
+// every shader becomes a string under its file name. the header is only rewritten when
+// it changes, so an unchanged shader does not rebuild ShaderBuilder.cpp
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+bool readFile(const std::string &filename, std::string &contents)
+{
+	std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+	if (!file)
+		return false;
+	std::ostringstream stream;
+	stream << file.rdbuf();
+	contents = stream.str();
+	return true;
+}
+
+// name.frag from any path, either separator
+std::string baseName(const std::string &path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// a line of the source per literal, the compiler joins them back together
+void appendLiteral(std::string &out, const std::string &source)
+{
+	out += "\t\t\"";
+	for (size_t i = 0; i < source.size(); i++)
+	{
+		char c = source[i];
+		if (c == '\r')
+			continue;
+		else if (c == '\n')
+		{
+			out += "\\n\"";
+			if (i + 1 < source.size())
+				out += "\n\t\t\"";
+			else
+				return;
+		}
+		else if (c == '\\')	out += "\\\\";
+		else if (c == '"')	out += "\\\"";
+		else if (c == '\t')	out += "\\t";
+		else				out += c;
+	}
+	out += "\"";
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		std::cout << "Usage: " << argv[0] << " <header> <shader>..." << std::endl;
+		return 1;
+	}
+
+	std::string out =
+		"#pragma once\n\n"
+		"// generated from shaders/ by tools/EmbedShaders.cpp on every build, edit the shaders instead.\n"
+		"// a file of the same name in the override directory (--shaders <dir>) takes precedence\n\n"
+		"struct EmbeddedShader\n{\n\tconst char* name;\n\tconst char* source;\n};\n\n"
+		"constexpr EmbeddedShader embeddedShaders[] =\n{\n";
+	for (int i = 2; i < argc; i++)
+	{
+		std::string source;
+		if (!readFile(argv[i], source))
+		{
+			std::cout << "SHADER " << argv[i] << " COULD NOT BE READ" << std::endl;
+			return 1;
+		}
+		out += "\t{ \"" + baseName(argv[i]) + "\",\n";
+		appendLiteral(out, source);
+		out += i + 1 < argc ? " },\n" : " }\n";
+	}
+	out += "};\n\nconstexpr int embeddedShaderCount = sizeof(embeddedShaders) / sizeof(embeddedShaders[0]);\n";
+
+	std::string previous;
+	if (readFile(argv[1], previous) && previous == out)
+		return 0;
+	std::ofstream header(argv[1], std::ios::out | std::ios::binary);
+	if (!header.write(out.data(), out.size()))
+	{
+		std::cout << "FILE " << argv[1] << " COULD NOT BE WRITTEN" << std::endl;
+		return 1;
+	}
+	return 0;
+}